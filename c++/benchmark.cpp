@@ -0,0 +1,141 @@
+#define VIRTUALLET_NO_MAIN
+#include "virtuallet.cpp"
+
+#include <random>
+
+static const string BENCHMARK_FILE = "benchmark_virtuallet.db";
+static const int CATCH_UP_MONTHS = 24;
+
+class NullBuffer : public std::streambuf {
+
+    protected:
+
+        int overflow(int c) override {
+            return c;
+        }
+
+        std::streamsize xsputn(const char *, std::streamsize n) override {
+            return n;
+        }
+
+};
+
+class Benchmark {
+
+    public:
+
+        Benchmark(const long rows) : rows(rows) {}
+
+        void run() {
+            std::remove(BENCHMARK_FILE.c_str());
+            generate();
+            SqliteDatabase db(BENCHMARK_FILE);
+            db.connect();
+            measure("insertIntoLedger", 2000, [&db]() {
+                db.insertIntoLedger("benchmark", -199);
+            });
+            measure("balance", 10000, [&db]() {
+                db.balance();
+            });
+            NullBuffer buffer;
+            std::ostream nowhere(&buffer);
+            measure("transactions", 2000, [&db, &nowhere]() {
+                db.transactions(nowhere, std::numeric_limits<int64_t>::max(), 30);
+            });
+            measure("isExpenseAcceptable", 10000, [&db]() {
+                db.isExpenseAcceptable(4200);
+            });
+            measureCatchUp(db, 20);
+            db.disconnect();
+            std::remove(BENCHMARK_FILE.c_str());
+        }
+
+    private:
+
+        const long rows;
+
+        void generate() {
+            std::mt19937 random(42);
+            std::uniform_int_distribution<Cents> amounts(-15000, 5000);
+            const char *descriptions[] = {"groceries", "coffee", "book", "cinema", "train ticket", "gift", "lunch"};
+            const int periods = Util::currentYear() * 12 + Util::currentMonth() - 1 - CATCH_UP_MONTHS;
+            SqliteDatabase db(BENCHMARK_FILE);
+            db.connect();
+            db.createTables();
+            db.insertConfiguration(CONF_INCOME_DESCRIPTION, "pocket money");
+            db.insertConfiguration(CONF_INCOME_AMOUNT, "100");
+            db.insertConfiguration(CONF_OVERDRAFT, "200");
+            db.beginTransaction();
+            for (long i = 1; i < rows; i++) {
+                db.importIntoLedger(descriptions[i % 7], amounts(random), "");
+                if (i % IMPORT_BATCH_SIZE == 0) {
+                    db.commitTransaction();
+                    db.beginTransaction();
+                }
+            }
+            db.commitTransaction();
+            db.insertAutoIncome(periods % 12 + 1, periods / 12);
+            db.disconnect();
+        }
+
+        template<typename Operation>
+        void measure(const string name, const int iterations, Operation operation) {
+            std::vector<double> latencies;
+            latencies.reserve(iterations);
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; i++) {
+                const auto before = std::chrono::steady_clock::now();
+                operation();
+                latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - before).count());
+            }
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            report(name, latencies, elapsed.count());
+        }
+
+        void measureCatchUp(SqliteDatabase &db, const int iterations) {
+            sqlite3 *reset;
+            sqlite3_open(BENCHMARK_FILE.c_str(), &reset);
+            std::vector<double> latencies;
+            double total = 0;
+            for (int i = 0; i < iterations; i++) {
+                sqlite3_exec(reset, " DELETE FROM ledger WHERE auto_income = 1 AND rowid > (SELECT MIN(rowid) FROM ledger WHERE auto_income = 1) ", 0, 0, 0);
+                const auto before = std::chrono::steady_clock::now();
+                db.insertAllDueIncomes();
+                const double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - before).count();
+                latencies.push_back(micros);
+                total += micros;
+            }
+            sqlite3_close(reset);
+            report("insertAllDueIncomes", latencies, total / 1000000);
+        }
+
+        void report(const string name, std::vector<double> &latencies, const double seconds) {
+            std::sort(latencies.begin(), latencies.end());
+            printf("{\"rows\": %ld, \"operation\": \"%s\", \"iterations\": %zu, "
+                "\"p50_us\": %.1f, \"p90_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f, \"ops_per_sec\": %.0f}\n",
+                rows, name.c_str(), latencies.size(),
+                percentile(latencies, 0.50), percentile(latencies, 0.90), percentile(latencies, 0.99),
+                latencies.back(), latencies.size() / seconds);
+            fflush(stdout);
+        }
+
+        double percentile(const std::vector<double> &sorted, const double p) {
+            return sorted[static_cast<size_t>(p * (sorted.size() - 1))];
+        }
+
+};
+
+int main(int argc, char *argv[]) {
+	std::vector<long> sizes = {1000, 100000, 1000000, 10000000};
+	if (argc > 1) {
+		sizes.clear();
+		for (int i = 1; i < argc; i++) {
+			sizes.push_back(std::atol(argv[i]));
+		}
+	}
+	for (const long rows : sizes) {
+		Benchmark benchmark(rows);
+		benchmark.run();
+	}
+	return 0;
+}
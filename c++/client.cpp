@@ -0,0 +1,122 @@
+#define VIRTUALLET_NO_MAIN
+#include "virtuallet.cpp"
+
+class Client {
+
+    public:
+
+        string socket = DAEMON_SOCKET;
+        string wallet;
+        std::vector<string> command;
+
+        bool parse(int argc, char *argv[]) {
+            int i = 1;
+            for (; i + 1 < argc && argv[i][0] == '-' && argv[i][1] == '-'; i += 2) {
+                const string option = argv[i];
+                if (option == "--socket") {
+                    socket = argv[i + 1];
+                } else if (option == "--wallet") {
+                    wallet = argv[i + 1];
+                } else {
+                    return false;
+                }
+            }
+            command.assign(argv + i, argv + argc);
+            return !command.empty();
+        }
+
+        int request() {
+            string payload = command[0] + "\t" + wallet;
+            for (size_t i = 1; i < command.size(); i++) {
+                payload += "\t" + command[i];
+            }
+            const int fd = connectDaemon();
+            string reply;
+            if (fd < 0 || !Frame::send(fd, payload) || !Frame::receive(fd, reply)) {
+                printf("cannot reach daemon on %s\n", socket.c_str());
+                return 1;
+            }
+            close(fd);
+            const size_t tab = reply.find('\t');
+            printf("%s\n", reply.substr(tab + 1).c_str());
+            return reply.compare(0, tab, "ok") == 0 ? 0 : 1;
+        }
+
+        int load() {
+            const int clients = command.size() > 1 ? std::max(1, std::atoi(command[1].c_str())) : 8;
+            const long requests = command.size() > 2 ? std::max(1L, std::atol(command[2].c_str())) : 10000;
+            const int writes = command.size() > 3 ? std::atoi(command[3].c_str()) : 10;
+            std::vector<std::vector<double>> latencies(clients);
+            std::atomic<long> failures(0);
+            std::atomic<long> rejected(0);
+            std::vector<std::thread> pool;
+            const auto start = std::chrono::steady_clock::now();
+            for (int c = 0; c < clients; c++) {
+                pool.emplace_back([this, c, clients, requests, writes, &latencies, &failures, &rejected]() {
+                    const int fd = connectDaemon();
+                    for (long i = c; i < requests; i += clients) {
+                        const auto before = std::chrono::steady_clock::now();
+                        string reply;
+                        if (fd < 0 || !Frame::send(fd, mix(i, writes)) || !Frame::receive(fd, reply)) {
+                            failures++;
+                        } else if (reply.compare(0, 3, "ok\t") != 0) {
+                            rejected++;
+                        }
+                        latencies[c].push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - before).count());
+                    }
+                    close(fd);
+                });
+            }
+            for (std::thread &client : pool) {
+                client.join();
+            }
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::vector<double> all;
+            for (const std::vector<double> &client : latencies) {
+                all.insert(all.end(), client.begin(), client.end());
+            }
+            std::sort(all.begin(), all.end());
+            printf("{\"clients\": %d, \"requests\": %zu, \"writes_percent\": %d, \"failures\": %ld, \"rejected\": %ld, "
+                "\"p50_us\": %.1f, \"p90_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f, \"ops_per_sec\": %.0f}\n",
+                clients, all.size(), writes, failures.load(), rejected.load(),
+                percentile(all, 0.50), percentile(all, 0.90), percentile(all, 0.99),
+                all.back(), all.size() / elapsed.count());
+            return failures > 0 ? 1 : 0;
+        }
+
+    private:
+
+        int connectDaemon() {
+            struct sockaddr_un address = {};
+            address.sun_family = AF_UNIX;
+            strncpy(address.sun_path, socket.c_str(), sizeof(address.sun_path) - 1);
+            const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd >= 0 && connect(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) < 0) {
+                close(fd);
+                return -1;
+            }
+            return fd;
+        }
+
+        string mix(const long i, const int writes) {
+            if (i % 100 < writes) {
+                return (i % 2 == 0 ? "add\t" : "sub\t") + wallet + "\t0.01\tload test";
+            }
+            return (i % 10 == 0 ? "show\t" : "balance\t") + wallet;
+        }
+
+        static double percentile(const std::vector<double> &sorted, const double p) {
+            return sorted[static_cast<size_t>(p * (sorted.size() - 1))];
+        }
+
+};
+
+int main(int argc, char *argv[]) {
+	Client client;
+	if (!client.parse(argc, argv)) {
+		printf("usage: client.out [--socket path] [--wallet name] balance | add <amount> <description> | sub <amount> <description> | show [limit]\n");
+		printf("       client.out [--socket path] [--wallet name] load [clients] [requests] [writes percent]\n");
+		return 1;
+	}
+	return client.command[0] == "load" ? client.load() : client.request();
+}
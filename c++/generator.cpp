@@ -0,0 +1,207 @@
+#define VIRTUALLET_NO_MAIN
+#include "virtuallet.cpp"
+
+#include <random>
+#include <sstream>
+
+class Generator {
+
+    public:
+
+        string file;
+        long rows = 1000000;
+        string from = "2015-01-01";
+        string to = "2024-12-31";
+        int incomeEvery = 1;
+        std::vector<string> vocabulary = {"groceries", "coffee", "book", "cinema", "train ticket", "gift", "lunch", "dentist"};
+        unsigned long seed = 42;
+
+        bool parse(int argc, char *argv[]) {
+            if (argc < 2 || argv[1][0] == '-') {
+                return false;
+            }
+            file = argv[1];
+            for (int i = 2; i < argc; i += 2) {
+                if (i + 1 == argc) {
+                    return false;
+                }
+                const string option = argv[i];
+                const string value = argv[i + 1];
+                unsigned long number = 0;
+                if (option == "--rows" && parseNumber(value, number) && number <= static_cast<unsigned long>(std::numeric_limits<long>::max())) {
+                    rows = number;
+                } else if (option == "--from" && isDate(value)) {
+                    from = value;
+                } else if (option == "--to" && isDate(value)) {
+                    to = value;
+                } else if (option == "--income-every" && parseNumber(value, number) && number <= 1200) {
+                    incomeEvery = number;
+                } else if (option == "--vocabulary") {
+                    vocabulary = split(value);
+                } else if (option == "--seed" && parseNumber(value, number)) {
+                    seed = number;
+                } else {
+                    return false;
+                }
+            }
+            return rows > 0 && incomeEvery > 0 && !vocabulary.empty() && toEpoch(from) < toEpoch(to);
+        }
+
+        bool generate() {
+            const auto start = std::chrono::steady_clock::now();
+            if (!createDatabase()) {
+                return false;
+            }
+            sqlite3 *db;
+            if (sqlite3_open(file.c_str(), &db) != SQLITE_OK) {
+                printf("cannot open %s: %s\n", file.c_str(), sqlite3_errmsg(db));
+                sqlite3_close(db);
+                return false;
+            }
+            sqlite3_exec(db, " PRAGMA journal_mode = OFF; PRAGMA synchronous = OFF; PRAGMA cache_size = -262144 ", 0, 0, 0);
+            sqlite3_exec(db, R"(
+                DROP TRIGGER IF EXISTS ledger_cents_insert; DROP TRIGGER IF EXISTS ledger_balance_insert;
+                DROP TRIGGER IF EXISTS ledger_income_period_insert; DROP TRIGGER IF EXISTS ledger_monthly_insert;
+                DROP TRIGGER IF EXISTS ledger_epoch_insert
+            )", 0, 0, 0);
+            sqlite3_stmt *stmt;
+            if (sqlite3_prepare_v2(db, " INSERT INTO ledger (description, amount, amount_cents, auto_income, income_period, created_at, created_epoch, created_by) VALUES (?1, ?2 / 100.0, ?2, ?3, ?4, ?5, ?6, 'C++17 Edition') ", -1, &stmt, 0) != SQLITE_OK) {
+                printf("cannot prepare the insert into %s: %s\n", file.c_str(), sqlite3_errmsg(db));
+                sqlite3_close(db);
+                return false;
+            }
+            std::mt19937_64 random(seed);
+            std::uniform_int_distribution<size_t> words(0, vocabulary.size() - 1);
+            std::uniform_int_distribution<Cents> expenses(1, 15000);
+            std::uniform_int_distribution<int> kinds(0, 9);
+            const time_t first = toEpoch(from);
+            const double step = static_cast<double>(toEpoch(to) - first) / rows;
+            int lastPeriod = 0;
+            long written = 0;
+            sqlite3_exec(db, " BEGIN ", 0, 0, 0);
+            while (written < rows) {
+                if (written > 0 && written % IMPORT_BATCH_SIZE == 0) {
+                    sqlite3_exec(db, " COMMIT; BEGIN ", 0, 0, 0);
+                }
+                const time_t epoch = first + static_cast<time_t>(written * step);
+                struct tm date;
+                gmtime_r(&epoch, &date);
+                const int period = (date.tm_year + 1900) * 100 + date.tm_mon + 1;
+                const int months = (date.tm_year + 1900) * 12 + date.tm_mon;
+                if (period != lastPeriod && months % incomeEvery == 0) {
+                    char description[48];
+                    snprintf(description, sizeof(description), "pocket money %02d/%d", date.tm_mon + 1, date.tm_year + 1900);
+                    insert(stmt, description, 10000, 1, period, epoch, date);
+                    lastPeriod = period;
+                    written++;
+                    continue;
+                }
+                const bool income = kinds(random) == 0;
+                insert(stmt, vocabulary[words(random)], income ? expenses(random) * 2 : -expenses(random), 0, 0, epoch, date);
+                written++;
+            }
+            sqlite3_exec(db, " COMMIT ", 0, 0, 0);
+            sqlite3_finalize(stmt);
+            sqlite3_close(db);
+            SqliteDatabase database(file);
+            database.connect();
+            if (!database.reinstallTriggers()) {
+                printf("cannot restore the triggers of %s\n", file.c_str());
+            }
+            database.recalculateBalance();
+            database.rebuildMonthly();
+            database.disconnect();
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            printf("generated %ld rows in %.2fs (%.0f rows/s)\n", written, elapsed.count(), written / elapsed.count());
+            return true;
+        }
+
+    private:
+
+        bool createDatabase() {
+            SqliteDatabase database(file);
+            if (!database.connect()) {
+                return false;
+            }
+            database.createTables();
+            database.insertConfiguration(CONF_INCOME_DESCRIPTION, "pocket money");
+            database.insertConfiguration(CONF_INCOME_AMOUNT, "100");
+            database.insertConfiguration(CONF_OVERDRAFT, "200");
+            const bool created = !database.hasFailed();
+            database.disconnect();
+            return created;
+        }
+
+        void insert(sqlite3_stmt *stmt, const string description, const Cents amount, const int autoIncome, const int period, const time_t epoch, const struct tm &date) {
+            char createdAt[20];
+            strftime(createdAt, sizeof(createdAt), "%Y-%m-%d %H:%M:%S", &date);
+            sqlite3_bind_text(stmt, 1, description.c_str(), description.length(), SQLITE_TRANSIENT);
+            sqlite3_bind_int64(stmt, 2, amount);
+            sqlite3_bind_int(stmt, 3, autoIncome);
+            if (period > 0) {
+                sqlite3_bind_int(stmt, 4, period);
+            } else {
+                sqlite3_bind_null(stmt, 4);
+            }
+            sqlite3_bind_text(stmt, 5, createdAt, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(stmt, 6, epoch);
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+
+        static bool parseNumber(const string value, unsigned long &number) {
+            char *end;
+            errno = 0;
+            number = strtoul(value.c_str(), &end, 10);
+            return !value.empty() && isdigit(static_cast<unsigned char>(value[0])) && *end == '\0' && errno != ERANGE;
+        }
+
+        // timegm quietly turns 2024-13-45 into a date in 2025, so only dates that survive the round trip are valid.
+        static bool isDate(const string date) {
+            if (date.size() != 10 || !Util::isTimestamp(date)) {
+                return false;
+            }
+            const time_t epoch = toEpoch(date);
+            struct tm parsed;
+            gmtime_r(&epoch, &parsed);
+            char formatted[16];
+            strftime(formatted, sizeof(formatted), "%Y-%m-%d", &parsed);
+            return date == formatted;
+        }
+
+        static time_t toEpoch(const string date) {
+            struct tm parsed = {};
+            if (sscanf(date.c_str(), "%d-%d-%d", &parsed.tm_year, &parsed.tm_mon, &parsed.tm_mday) != 3) {
+                return 0;
+            }
+            parsed.tm_year -= 1900;
+            parsed.tm_mon -= 1;
+            return timegm(&parsed);
+        }
+
+        static std::vector<string> split(const string value) {
+            std::vector<string> result;
+            std::stringstream stream(value);
+            string word;
+            while (getline(stream, word, ',')) {
+                if (!word.empty()) {
+                    result.push_back(word);
+                }
+            }
+            return result;
+        }
+
+};
+
+int main(int argc, char *argv[]) {
+	Generator generator;
+	if (!generator.parse(argc, argv)) {
+		printf("usage: generator.out <file> [--rows n] [--from yyyy-mm-dd] [--to yyyy-mm-dd] [--income-every months] [--vocabulary a,b,c] [--seed n]\n");
+		return 1;
+	}
+	if (Util::fileExists(generator.file)) {
+		printf("%s already exists\n", generator.file.c_str());
+		return 1;
+	}
+	return generator.generate() ? 0 : 1;
+}
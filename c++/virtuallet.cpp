@@ -1,70 +1,202 @@
 #include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
 #include <math.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
 #include <sqlite3.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <arpa/inet.h>
 #include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/un.h>
 #include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <future>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <iostream>
-#include <list>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
 
 using std::string;
 
+typedef int64_t Cents;
+
 static const string CONF_INCOME_DESCRIPTION = "income_description";
 static const string CONF_INCOME_AMOUNT = "income_amount";
 static const string CONF_OVERDRAFT = "overdraft";
+static const string CONF_PAGE_SIZE = "page_size";
+static const string CONF_STORAGE_PROFILE = "storage_profile";
+static const string CONF_STORAGE_JOURNAL_MODE = "storage_journal_mode";
+static const string CONF_STORAGE_SYNCHRONOUS = "storage_synchronous";
+static const string CONF_STORAGE_MMAP_SIZE = "storage_mmap_size";
+static const string CONF_STORAGE_CACHE_SIZE = "storage_cache_size";
+static const string CONF_STORAGE_TEMP_STORE = "storage_temp_store";
+static const string CONF_SLOW_QUERY_MS = "slow_query_ms";
+static const string CONF_SLOW_QUERY_LOG = "slow_query_log";
+static const string STORAGE_PROFILE_FAST = "fast";
 static const string DB_FILE = "../db_virtuallet.db";
+static const string JOURNAL_FILE = "../db_virtuallet.journal";
+static const string MEMORY_DB = ":memory:";
+static const string DAEMON_SOCKET = "../virtuallet.sock";
+static const string SLOW_QUERY_LOG = "../virtuallet_slow.log";
+static const string JOURNAL_SUFFIX = ".journal";
+static const string SEARCH_SUFFIX = "-search";
+static const char JOURNAL_MAGIC[8] = {'V', 'L', 'J', 'R', 'N', 'L', '0', '1'};
 static const string TAB = "<TAB>";
+static const string ARG_IMPORT = "--import";
+static const string ARG_EXPORT = "--export";
+static const string ARG_FROM = "--from";
+static const string ARG_TO = "--to";
+static const string FORMAT_CSV = "csv";
+static const string FORMAT_JSONL = "jsonl";
+static const string ARG_JOURNAL = "--journal";
+static const string ARG_MEMORY = "--memory";
+static const string ARG_WALLETS = "--wallets";
+static const string ARG_DAEMON = "--daemon";
+static const string ARG_SOCKET = "--socket";
+static const string ARG_STATS = "--stats";
+static const int IMPORT_BATCH_SIZE = 50000;
+static const int OUTPUT_BUFFER_SIZE = 65536;
+static const int EXPORT_BUFFER_SIZE = 1 << 20;
+static const int64_t RANGE_FIRST = 0;
+static const int64_t RANGE_LAST = 253402300800;
+static const int BUSY_TIMEOUT_MS = 5000;
+static const int DAEMON_READERS = 4;
+static const int DAEMON_BACKOFF_MS = 100;
+static const int DAEMON_TIMEOUT_MS = 1000;
+static const uint32_t FRAME_LIMIT = 1 << 24;
+static const int HISTOGRAM_BUCKETS = 32;
+static const long SLOW_QUERY_LOG_LIMIT = 1 << 20;
+static const int SLOW_QUERY_LOG_FILES = 3;
 
 class TextResources {
     public:
-        static string banner();
-        static string info();
-        static string help();
-        static string setupPreDatabase();
-        static string setupPostDatabase();
-        static string setupComplete();
-        static string errorOmg();
-        static string errorZeroOrInvalidAmount();
-        static string errorNegativeAmount();
-        static string incomeBooked();
-        static string expenseBooked();
-        static string errorTooExpensive();
-        static string enterInput();
-        static string enterDescription();
-        static string enterAmount();
-        static string bye();
-        static string currentBalance(const double value);
-        static string formattedBalance(const double balance, const string formattedBalance);
-        static string setupDescription();
-        static string setupIncome();
-        static string setupOverdraft();
+        static const string & banner();
+        static const string & info();
+        static const string & help();
+        static const string & setupPreDatabase();
+        static const string & setupPostDatabase();
+        static const string & setupComplete();
+        static const string & errorOmg();
+        static const string & errorZeroOrInvalidAmount();
+        static const string & errorNegativeAmount();
+        static const string & incomeBooked();
+        static const string & expenseBooked();
+        static const string & errorTooExpensive();
+        static const string & enterInput();
+        static const string & enterDescription();
+        static const string & enterAmount();
+        static const string & bye();
+        static const string & balanceRecalculated();
+        static string currentBalance(const Cents value);
+        static string formattedBalance(const Cents balance, const int pageSize);
+        static const string & olderTransactions();
+        static const string & noOlderTransactions();
+        static const string & wallets();
+        static string walletEntry(const size_t number, const string name, const Cents balance);
+        static const string & enterWallet();
+        static string activeWallet(const string name);
+        static const string & errorSingleWallet();
+        static const string & errorInvalidWallet();
+        static const string & errorNoWallets();
+        static const string & oneShotUsage();
+        static string errorMissingWallet(const string name);
+        static string errorJournal(const string file, const string reason);
+        static string errorDatabase(const string file, const string reason);
+        static string errorStatement(const string reason);
+        static string errorUnavailableWallet(const string name);
+        static string errorNotBooked(const string description, const Cents amount);
+        static string errorSocket(const string socket);
+        static string errorAccept(const string reason);
+        static string errorNotSaved(const string name);
+        static const string & errorUnknownCommand();
+        static string daemonListening(const string socket, const size_t wallets);
+        static const string & daemonStopped();
+        static const string & monthlySummary();
+        static const string & stats();
+        static const string & enterSearch();
+        static const string & errorEmptySearch();
+        static const string & enterFrom();
+        static const string & enterTo();
+        static const string & enterSign();
+        static const string & errorInvalidRange();
+        static string snapshotLoaded(const size_t rows, const double seconds);
+        static string rangeTotals(const long count, const Cents sum, const Cents min, const Cents max);
+        static string rangeComparison(const double micros, const double sqlMicros, const bool matching);
+        static string rangeTiming(const double micros);
+        static string periodTransactions(const int pageSize);
+        static string migrationStarted(const string file, const int from, const int to);
+        static string migrationApplied(const int version, const string name, const double seconds);
+        static string errorMigration(const string file, const int version, const string name, const string reason);
+        static string periodBalance(const long entries, const Cents income, const Cents expenses, const Cents opening, const Cents closing);
+        static string searchResults(const int pageSize);
+        static string searchTotals(const long matches, const Cents income, const Cents expense);
+        static string monthlyRebuilt(const int months);
+        static const string & setupDescription();
+        static const string & setupIncome();
+        static const string & setupOverdraft();
         static string setupTemplate(const string description, const string standard);
+        static const string & errorNoDatabase();
+        static string errorFileNotFound(const string filename);
+        static string errorFileNotWritable(const string filename);
+        static const string & exportUsage();
+        static string exportComplete(const long exported, const double seconds);
+        static string importComplete(const long imported, const long skipped, const long rejected, const double seconds);
+        static string errorImportNotSaved(const long saved);
 };
 
 class Util {
 
     public:
 
+        static const Cents MAX_UNITS = 100000000000000LL;
+
         static bool fileExists(const string filename) {
             struct stat buffer;
             return stat (filename.c_str(), &buffer) == 0;
         }
 
-        static void print(string str) {
-            std::cout << Util::replaceAll(str, TAB, "\t");
+        static void setupConsole() {
+            static char buffer[OUTPUT_BUFFER_SIZE];
+            std::ios::sync_with_stdio(false);
+            std::cout.rdbuf()->pubsetbuf(buffer, sizeof(buffer));
+        }
+
+        static void print(const string &str) {
+            std::cout << str;
         }
 
-        static void println(string str) {
-            std::cout << str << std::endl;
+        static void println(const string &str) {
+            std::cout << str << '\n';
         }
 
         static string input(const string prefix) {
-            Util::print(prefix + " > ");
+            std::cout << prefix << " > ";
+            std::cout.flush();
             string result;
             getline(std::cin, result);
             return result;
@@ -81,18 +213,60 @@ class Util {
             return strdup(chr);
         }
 
-        static struct tm * now() {
+        static struct tm now() {
             time_t now;
+            struct tm local;
             time(&now);
-            return localtime(&now);
+            localtime_r(&now, &local);
+            return local;
         }
 
         static int currentMonth() {
-            return now()->tm_mon + 1;
+            return now().tm_mon + 1;
         }
 
         static int currentYear() {
-            return now()->tm_year + 1900;
+            return now().tm_year + 1900;
+        }
+
+        static bool isDate(const string &date) {
+            int year, month, day;
+            return date.empty() || (date.size() == 10 && sscanf(date.c_str(), "%4d-%2d-%2d", &year, &month, &day) == 3);
+        }
+
+        static bool isTimestamp(const string &timestamp) {
+            static const char pattern[] = "dddd-dd-dd dd:dd:dd";
+            if (timestamp.size() != 10 && timestamp.size() != 19) {
+                return false;
+            }
+            for (size_t i = 0; i < timestamp.size(); i++) {
+                if (pattern[i] == 'd' ? !isdigit(static_cast<unsigned char>(timestamp[i])) : timestamp[i] != pattern[i]) {
+                    return false;
+                }
+            }
+            const int month = std::atoi(timestamp.c_str() + 5);
+            const int day = std::atoi(timestamp.c_str() + 8);
+            return month >= 1 && month <= 12 && day >= 1 && day <= 31 && (timestamp.size() == 10
+                || (std::atoi(timestamp.c_str() + 11) < 24 && std::atoi(timestamp.c_str() + 14) < 60 && std::atoi(timestamp.c_str() + 17) < 60));
+        }
+
+        static time_t parseTimestamp(const string str) {
+            struct tm parsed = {};
+            if (sscanf(str.c_str(), "%d-%d-%d %d:%d:%d", &parsed.tm_year, &parsed.tm_mon, &parsed.tm_mday,
+                    &parsed.tm_hour, &parsed.tm_min, &parsed.tm_sec) < 3) {
+                return time(NULL);
+            }
+            parsed.tm_year -= 1900;
+            parsed.tm_mon -= 1;
+            return timegm(&parsed);
+        }
+
+        static string formatTimestamp(const time_t epoch) {
+            struct tm date;
+            char str[20];
+            gmtime_r(&epoch, &date);
+            strftime(str, sizeof(str), "%Y-%m-%d %H:%M:%S", &date);
+            return string(str);
         }
 
         static string toFormattedString(const double d) {
@@ -104,326 +278,3337 @@ class Util {
 
         }
 
+        static Cents parseCents(const string str) {
+            const char *c = str.c_str();
+            while (isspace(*c)) {
+                c++;
+            }
+            const int signum = *c == '-' ? -1 : 1;
+            if (*c == '-' || *c == '+') {
+                c++;
+            }
+            Cents units = 0;
+            for (; isdigit(*c); c++) {
+                if (units > MAX_UNITS) {
+                    return 0;
+                }
+                units = units * 10 + (*c - '0');
+            }
+            Cents fraction = 0;
+            if (*c == '.') {
+                c++;
+                for (int digits = 0; digits < 3; digits++) {
+                    fraction = fraction * 10 + (isdigit(*c) ? *c++ - '0' : 0);
+                }
+            }
+            return signum * (units * 100 + (fraction + 5) / 10);
+        }
+
+        static string formatCents(const Cents cents) {
+            char str[32];
+            const Cents absolute = cents < 0 ? -cents : cents;
+            snprintf(str, sizeof(str), "%s%lld.%02lld", cents < 0 ? "-" : "", (long long) (absolute / 100), (long long) (absolute % 100));
+            return string(str);
+        }
+
+        static string expand(const string str) {
+            return Util::replaceAll(str, TAB, "\t");
+        }
+
+        static string fill(const string &str, const string value) {
+            const size_t found = str.find('?');
+            return found == string::npos ? str : string(str, 0, found) + value + string(str, found + 1);
+        }
+
         static string replaceAll(string str, const string occurrence, const string replacement) {
-            int found = str.find(occurrence);
+            size_t found = str.find(occurrence);
             while(found != string::npos) {
-                str.replace(str.find(occurrence), occurrence.length(), replacement);
-                found = str.find(occurrence);
+                str.replace(found, occurrence.length(), replacement);
+                found = str.find(occurrence, found + replacement.length());
             }
             return str;
         }
 
 };
 
-class Database {
+class Metric {
 
     public:
 
-        void connect() {
-            if (!db) {
-                sqlite3_open(DB_FILE.c_str(), &db);
+        void record(const uint64_t micros) {
+            count++;
+            total += micros;
+            uint64_t highest = max;
+            while (micros > highest && !max.compare_exchange_weak(highest, micros)) {}
+            int bucket = 0;
+            while (bucket < HISTOGRAM_BUCKETS - 1 && micros >> bucket > 0) {
+                bucket++;
             }
+            buckets[bucket]++;
         }
 
-        void disconnect() {
-            sqlite3_close(db);
+        uint64_t percentile(const double p) const {
+            const uint64_t rank = static_cast<uint64_t>(p * count);
+            uint64_t seen = 0;
+            for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+                seen += buckets[bucket];
+                if (seen > rank) {
+                    return std::min<uint64_t>(bucket == 0 ? 0 : (1ULL << bucket) - 1, max);
+                }
+            }
+            return max;
         }
 
-        void createTables() {
-            executeStatement(R"(
-                CREATE TABLE ledger (
-                description TEXT,
-                amount REAL NOT NULL,
-                auto_income INTEGER NOT NULL,
-                created_by TEXT,
-                created_at TIMESTAMP NOT NULL,
-                modified_at TIMESTAMP)
-            )");
-            executeStatement(" CREATE TABLE configuration (k TEXT NOT NULL, v TEXT NOT NULL)");
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> total{0};
+        std::atomic<uint64_t> max{0};
+        std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS] = {};
+
+};
+
+class Timer {
+
+    public:
+
+        Timer(Metric &metric) : metric(metric), start(std::chrono::steady_clock::now()) {}
+
+        ~Timer() {
+            metric.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
         }
 
-        void insertAutoIncome(int month, int year) {
-            int requiredSize = 9;
-            char dateInfo[requiredSize];
-            snprintf(dateInfo, requiredSize, " %02d/%d", month, year);
-            const string description = incomeDescription() + dateInfo;
-            const float amount = incomeAmount();
-            sqlite3_stmt *stmt;
-            sqlite3_prepare_v2(db, " INSERT INTO ledger (description, amount, auto_income, created_at, created_by) VALUES (?, ROUND(?, 2), 1, datetime('now'), 'C++17 Edition') ", -1, &stmt, 0);
-            sqlite3_bind_text(stmt, 1, description.c_str(), description.length(), NULL);
-            sqlite3_bind_double(stmt, 2, amount);
-            sqlite3_step(stmt);
-            sqlite3_finalize(stmt);
+    private:
+
+        Metric &metric;
+        const std::chrono::steady_clock::time_point start;
+
+};
+
+class Stats {
+
+    public:
+
+        static Metric & metric(const string name) {
+            std::lock_guard<std::mutex> lock(mutex());
+            std::unique_ptr<Metric> &metric = metrics()[name];
+            if (!metric) {
+                metric.reset(new Metric());
+            }
+            return *metric;
         }
 
-        void insertConfiguration(const string key, const string value) {
-            sqlite3_stmt *stmt;
-            sqlite3_prepare_v2(db, " INSERT INTO configuration (k, v) VALUES (?, ?)", -1, &stmt, 0);
-            sqlite3_bind_text(stmt, 1, key.c_str(), key.length(), NULL);
-            sqlite3_bind_text(stmt, 2, value.c_str(), value.length(), NULL);
-            sqlite3_step(stmt);
-            sqlite3_finalize(stmt);
+        static void print(std::ostream &out) {
+            std::lock_guard<std::mutex> lock(mutex());
+            char line[160];
+            for (const auto &entry : metrics()) {
+                const Metric &metric = *entry.second;
+                snprintf(line, sizeof(line), "\t%-32s\t%8lu\t%10.1f\t%8lu\t%8lu\t%8lu\n", entry.first.c_str(),
+                    static_cast<unsigned long>(metric.count.load()), metric.total / 1000.0,
+                    static_cast<unsigned long>(metric.percentile(0.50)), static_cast<unsigned long>(metric.percentile(0.99)),
+                    static_cast<unsigned long>(metric.max.load()));
+                out << line;
+            }
         }
 
-        void insertIntoLedger(const string description, const float amount) {
-            sqlite3_stmt *stmt;
-            sqlite3_prepare_v2(db, " INSERT INTO ledger (description, amount, auto_income, created_at, created_by) VALUES (?, ROUND(?, 2), 0, datetime('now'), 'C++17 Edition') ", -1, &stmt, 0);
-            sqlite3_bind_text(stmt, 1, description.c_str(), description.length(), NULL);
-            sqlite3_bind_double(stmt, 2, amount);
-            sqlite3_step(stmt);
-            sqlite3_finalize(stmt);
+        static void writeJson(std::ostream &out) {
+            std::lock_guard<std::mutex> lock(mutex());
+            out << "{";
+            for (auto entry = metrics().begin(); entry != metrics().end(); entry++) {
+                const Metric &metric = *entry->second;
+                out << (entry == metrics().begin() ? "" : ",") << "\n  \"" << escaped(entry->first) << "\": {\"count\": " << metric.count
+                    << ", \"total_us\": " << metric.total << ", \"p50_us\": " << metric.percentile(0.50)
+                    << ", \"p99_us\": " << metric.percentile(0.99) << ", \"max_us\": " << metric.max << ", \"buckets\": [";
+                for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+                    out << (bucket == 0 ? "" : ", ") << metric.buckets[bucket];
+                }
+                out << "]}";
+            }
+            out << "\n}\n";
         }
 
-        float balance() {
-            sqlite3_stmt *stmt;
-            sqlite3_prepare_v2(db, " SELECT ROUND(COALESCE(SUM(amount), 0), 2) FROM ledger ", -1, &stmt, 0);
-            sqlite3_step(stmt);
-            float balance = sqlite3_column_double(stmt, 0);
-            sqlite3_finalize(stmt);
-            return balance;
+        static void dumpOnExit(const string filename) {
+            dumpFile() = filename;
+            mutex();
+            metrics();
+            std::atexit([]() {
+                std::ofstream out(dumpFile());
+                writeJson(out);
+            });
+        }
+
+    private:
+
+        static std::mutex & mutex() {
+            static std::mutex mutex;
+            return mutex;
+        }
+
+        static std::map<string, std::unique_ptr<Metric>> & metrics() {
+            static std::map<string, std::unique_ptr<Metric>> metrics;
+            return metrics;
+        }
+
+        static string escaped(const string &name) {
+            string result;
+            for (const char c : name) {
+                if (c == '"' || c == '\\') {
+                    result += '\\';
+                    result += c;
+                } else if (static_cast<unsigned char>(c) < 0x20) {
+                    char code[8];
+                    snprintf(code, sizeof(code), "\\u%04x", c);
+                    result += code;
+                } else {
+                    result += c;
+                }
+            }
+            return result;
+        }
+
+        static string & dumpFile() {
+            static string file;
+            return file;
+        }
+
+};
+
+class SlowQueryLog {
+
+    public:
+
+        static void write(const string &file, const string &line) {
+            static std::mutex mutex;
+            std::lock_guard<std::mutex> lock(mutex);
+            struct stat info;
+            if (stat(file.c_str(), &info) == 0 && info.st_size + static_cast<long>(line.size()) > SLOW_QUERY_LOG_LIMIT) {
+                for (int generation = SLOW_QUERY_LOG_FILES - 1; generation > 0; generation--) {
+                    rename(generationOf(file, generation - 1).c_str(), generationOf(file, generation).c_str());
+                }
+            }
+            std::ofstream out(file, std::ios::app);
+            out << line;
+        }
+
+    private:
+
+        static string generationOf(const string &file, const int generation) {
+            return generation == 0 ? file : file + "." + std::to_string(generation);
+        }
+
+};
+
+class CsvReader {
+
+    public:
+
+        CsvReader(std::istream &stream) : in(stream) {}
+
+        bool next(std::vector<string> &fields) {
+            fields.clear();
+            if (!getline(in, line)) {
+                return false;
+            }
+            string field;
+            bool quoted = false;
+            size_t i = 0;
+            while (true) {
+                if (i == line.size()) {
+                    if (quoted && getline(in, line)) {
+                        field += '\n';
+                        i = 0;
+                        continue;
+                    }
+                    break;
+                }
+                const char c = line[i++];
+                if (quoted) {
+                    if (c == '"' && i < line.size() && line[i] == '"') {
+                        field += '"';
+                        i++;
+                    } else if (c == '"') {
+                        quoted = false;
+                    } else {
+                        field += c;
+                    }
+                } else if (c == '"') {
+                    quoted = true;
+                } else if (c == ',') {
+                    fields.push_back(field);
+                    field.clear();
+                } else if (c != '\r') {
+                    field += c;
+                }
+            }
+            fields.push_back(field);
+            return true;
+        }
+
+    private:
+
+        std::istream &in;
+        string line;
+
+};
+
+class Configuration {
+
+    public:
+
+        string incomeDescription;
+        Cents incomeAmount = 0;
+        Cents overdraft = 0;
+        int pageSize = 30;
+
+        void load(const std::unordered_map<string, string> &entries) {
+            values = entries;
+            incomeDescription = value(CONF_INCOME_DESCRIPTION, "");
+            incomeAmount = Util::parseCents(value(CONF_INCOME_AMOUNT, "0"));
+            overdraft = Util::parseCents(value(CONF_OVERDRAFT, "0"));
+            pageSize = std::max(1, std::atoi(value(CONF_PAGE_SIZE, "30").c_str()));
+        }
+
+        string value(const string key, const string standard) const {
+            auto entry = values.find(key);
+            return entry != values.end() ? entry->second : standard;
+        }
+
+    private:
+
+        std::unordered_map<string, string> values;
+
+};
+
+class Statement {
+
+    public:
+
+        Statement(sqlite3_stmt *stmt) : stmt(stmt) {}
+
+        Statement(const Statement&) = delete;
+
+        ~Statement() {
+            if (stmt) {
+                sqlite3_reset(stmt);
+                sqlite3_clear_bindings(stmt);
+            }
+        }
+
+        operator sqlite3_stmt *() const {
+            return stmt;
+        }
+
+    private:
+
+        sqlite3_stmt *stmt;
+
+};
+
+class SummaryWriter {
+
+    public:
+
+        SummaryWriter(std::ostream &stream) : out(stream) {}
+
+        // Rows whose created_at has no readable month end up in period 0 or a month outside 1 to 12.
+        // They are summed up separately instead of being shown as a month of a year that does not exist.
+        void month(const int period, const Cents income, const Cents expense, const long entries) {
+            if (period / 100 == 0 || period % 100 < 1 || period % 100 > 12) {
+                undatedIncome += income;
+                undatedExpense += expense;
+                undatedEntries += entries;
+                return;
+            }
+            if (year != 0 && period / 100 != year) {
+                finishYear();
+            }
+            year = period / 100;
+            closing += income + expense;
+            yearIncome += income;
+            yearExpense += expense;
+            yearEntries += entries;
+            snprintf(line, sizeof(line), "\t%d-%02d\t%12s\t%12s\t%8ld\t%12s\n", year, period % 100,
+                Util::formatCents(income).c_str(), Util::formatCents(expense).c_str(), entries, Util::formatCents(closing).c_str());
+            out << line;
+        }
+
+        void finish() {
+            finishYear();
+            if (undatedEntries != 0) {
+                snprintf(line, sizeof(line), "\tundated\t%12s\t%12s\t%8ld\n\n",
+                    Util::formatCents(undatedIncome).c_str(), Util::formatCents(undatedExpense).c_str(), undatedEntries);
+                out << line;
+            }
+        }
+
+    private:
+
+        void finishYear() {
+            if (year != 0) {
+                snprintf(line, sizeof(line), "\t%d   \t%12s\t%12s\t%8ld\t%12s\n\n", year,
+                    Util::formatCents(yearIncome).c_str(), Util::formatCents(yearExpense).c_str(), yearEntries, Util::formatCents(closing).c_str());
+                out << line;
+            }
+            year = 0;
+            yearIncome = 0;
+            yearExpense = 0;
+            yearEntries = 0;
+        }
+
+        std::ostream &out;
+        char line[120];
+        Cents closing = 0;
+        int year = 0;
+        Cents yearIncome = 0;
+        Cents yearExpense = 0;
+        long yearEntries = 0;
+        Cents undatedIncome = 0;
+        Cents undatedExpense = 0;
+        long undatedEntries = 0;
+
+};
+
+struct SearchTotals {
+    long matches;
+    Cents income;
+    Cents expense;
+};
+
+struct RangeTotals {
+    long count;
+    Cents sum;
+    Cents min;
+    Cents max;
+};
+
+class LedgerSnapshot {
+
+    public:
+
+        void add(const int64_t epoch, const Cents amount, const bool autoIncome, const char *description, const size_t length) {
+            auto interned = ids.find(std::string_view(description, length));
+            if (interned == ids.end()) {
+                descriptions.emplace_back(description, length);
+                interned = ids.emplace(descriptions.back(), descriptions.size() - 1).first;
+            }
+            epochs.push_back(epoch);
+            cents.push_back(amount);
+            autoIncomes.push_back(autoIncome);
+            descriptionIds.push_back(interned->second);
+        }
+
+        void seal() {
+            if (std::is_sorted(epochs.begin(), epochs.end())) {
+                return;
+            }
+            std::vector<uint32_t> order(epochs.size());
+            for (uint32_t i = 0; i < order.size(); i++) {
+                order[i] = i;
+            }
+            std::stable_sort(order.begin(), order.end(), [this](const uint32_t a, const uint32_t b) { return epochs[a] < epochs[b]; });
+            permute(epochs, order);
+            permute(cents, order);
+            permute(autoIncomes, order);
+            permute(descriptionIds, order);
+        }
+
+        size_t size() const {
+            return epochs.size();
+        }
+
+        RangeTotals aggregate(const int64_t first, const int64_t last, const int signum) const {
+            const size_t begin = std::lower_bound(epochs.begin(), epochs.end(), first) - epochs.begin();
+            const size_t end = std::lower_bound(epochs.begin(), epochs.end(), last) - epochs.begin();
+            if (signum > 0) {
+                return fold(begin, end, [](const Cents amount) { return amount > 0; });
+            } else if (signum < 0) {
+                return fold(begin, end, [](const Cents amount) { return amount < 0; });
+            }
+            return fold(begin, end, [](const Cents) { return true; });
+        }
+
+    private:
+
+        std::vector<int64_t> epochs;
+        std::vector<Cents> cents;
+        std::vector<uint8_t> autoIncomes;
+        std::vector<uint32_t> descriptionIds;
+        std::deque<string> descriptions;
+        std::unordered_map<std::string_view, uint32_t> ids;
+
+        template<typename Keep>
+        RangeTotals fold(const size_t begin, const size_t end, Keep keep) const {
+            const Cents *amounts = cents.data();
+            long count = 0;
+            Cents sum = 0;
+            Cents min = std::numeric_limits<Cents>::max();
+            Cents max = std::numeric_limits<Cents>::min();
+            for (size_t i = begin; i < end; i++) {
+                const Cents amount = amounts[i];
+                const bool kept = keep(amount);
+                count += kept;
+                sum += kept ? amount : 0;
+                min = std::min(min, kept ? amount : std::numeric_limits<Cents>::max());
+                max = std::max(max, kept ? amount : std::numeric_limits<Cents>::min());
+            }
+            return count > 0 ? RangeTotals{count, sum, min, max} : RangeTotals{0, 0, 0, 0};
+        }
+
+        template<typename T>
+        static void permute(std::vector<T> &values, const std::vector<uint32_t> &order) {
+            std::vector<T> permuted(values.size());
+            for (size_t i = 0; i < order.size(); i++) {
+                permuted[i] = values[order[i]];
+            }
+            values.swap(permuted);
+        }
+
+};
+
+class ExportWriter {
+
+    public:
+
+        ExportWriter(const int fd, const bool json) : fd(fd), json(json), buffer(new char[EXPORT_BUFFER_SIZE]) {}
+
+        void row(const char *createdAt, const size_t createdAtLength, const Cents cents,
+                const char *description, const size_t descriptionLength, const bool autoIncome) {
+            if (json) {
+                append("{\"created_at\":\"");
+                appendEscaped(createdAt, createdAtLength);
+                append("\",\"amount\":");
+                appendCents(cents);
+                append(",\"description\":\"");
+                appendEscaped(description, descriptionLength);
+                if (autoIncome) {
+                    append("\",\"auto_income\":true}\n");
+                } else {
+                    append("\",\"auto_income\":false}\n");
+                }
+            } else {
+                appendQuoted(description, descriptionLength);
+                append(",");
+                appendCents(cents);
+                append(",");
+                append(createdAt, createdAtLength);
+                append("\n");
+            }
+            rows++;
+        }
+
+        bool finish() {
+            flush();
+            return !failed;
+        }
+
+        long written() const {
+            return rows;
+        }
+
+    private:
+
+        const int fd;
+        const bool json;
+        std::unique_ptr<char[]> buffer;
+        size_t used = 0;
+        long rows = 0;
+        bool failed = false;
+
+        void flush() {
+            for (size_t done = 0; done < used && !failed;) {
+                const ssize_t count = ::write(fd, buffer.get() + done, used - done);
+                if (count < 0 && errno != EINTR) {
+                    failed = true;
+                } else if (count > 0) {
+                    done += count;
+                }
+            }
+            used = 0;
+        }
+
+        void reserve(const size_t length) {
+            if (used + length > EXPORT_BUFFER_SIZE) {
+                flush();
+            }
+        }
+
+        void append(const char *data, const size_t length) {
+            if (length > EXPORT_BUFFER_SIZE) {
+                flush();
+                for (size_t done = 0; done < length; done += EXPORT_BUFFER_SIZE) {
+                    append(data + done, std::min<size_t>(EXPORT_BUFFER_SIZE, length - done));
+                }
+                return;
+            }
+            reserve(length);
+            memcpy(buffer.get() + used, data, length);
+            used += length;
+        }
+
+        template<size_t N>
+        void append(const char (&literal)[N]) {
+            append(literal, N - 1);
+        }
+
+        void appendCents(const Cents cents) {
+            reserve(24);
+            char *out = buffer.get() + used;
+            Cents absolute = cents < 0 ? -cents : cents;
+            char digits[24];
+            int count = 0;
+            do {
+                digits[count++] = '0' + absolute % 10;
+                absolute /= 10;
+            } while (absolute > 0 || count < 3);
+            if (cents < 0) {
+                *out++ = '-';
+            }
+            while (count > 2) {
+                *out++ = digits[--count];
+            }
+            *out++ = '.';
+            *out++ = digits[1];
+            *out++ = digits[0];
+            used = out - buffer.get();
+        }
+
+        void appendQuoted(const char *data, const size_t length) {
+            if (!memchr(data, ',', length) && !memchr(data, '"', length) && !memchr(data, '\n', length)) {
+                append(data, length);
+                return;
+            }
+            append("\"");
+            const char *end = data + length;
+            for (const char *start = data; start < end;) {
+                const char *quote = static_cast<const char *>(memchr(start, '"', end - start));
+                const char *stop = quote ? quote + 1 : end;
+                append(start, stop - start);
+                if (quote) {
+                    append("\"");
+                }
+                start = stop;
+            }
+            append("\"");
+        }
+
+        void appendEscaped(const char *data, const size_t length) {
+            const char *start = data;
+            const char *end = data + length;
+            for (const char *c = data; c < end; c++) {
+                const unsigned char u = *c;
+                if (u >= 0x20 && u != '"' && u != '\\') {
+                    continue;
+                }
+                append(start, c - start);
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), u == '"' || u == '\\' ? "\\%c" : "\\u%04x", u);
+                append(escaped, strlen(escaped));
+                start = c + 1;
+            }
+            append(start, end - start);
+        }
+
+};
+
+class Database {
+
+    public:
+
+        static std::unique_ptr<Database> open(const string filename);
+
+        virtual ~Database() {}
+
+        virtual bool exists() = 0;
+        virtual bool connect() = 0;
+        virtual bool connectReadOnly() = 0;
+        virtual void disconnect() = 0;
+        virtual void createTables() = 0;
+        virtual bool insertAutoIncome(int month, int year) = 0;
+        virtual void insertConfiguration(const string key, const string value) = 0;
+        virtual bool insertIntoLedger(const string description, const Cents amount) = 0;
+        virtual bool importIntoLedger(const string description, const Cents amount, const string createdAt) = 0;
+        virtual void beginTransaction() = 0;
+        virtual bool commitTransaction() = 0;
+        virtual void rollbackTransaction() = 0;
+        virtual Cents balance() = 0;
+        virtual void recalculateBalance() = 0;
+        virtual int rebuildMonthly() = 0;
+        virtual bool isMonthlyConsistent() = 0;
+        virtual void monthlySummary(std::ostream &out) = 0;
+        virtual int64_t transactions(std::ostream &out, const int64_t beforeRowid, const int limit) = 0;
+        virtual SearchTotals search(std::ostream &out, const string terms, const int limit) = 0;
+        virtual void exportLedger(ExportWriter &writer, const string from, const string to) = 0;
+        virtual void loadSnapshot(LedgerSnapshot &snapshot) = 0;
+        virtual RangeTotals rangeTotals(const int64_t first, const int64_t last, const int signum) = 0;
+        virtual void rangeTransactions(std::ostream &out, const int64_t first, const int64_t last, const int limit) = 0;
+        virtual Cents balanceBefore(const int64_t epoch) = 0;
+        virtual const Configuration & configuration() = 0;
+        virtual int lastIncomePeriod() = 0;
+        virtual bool isShareable() = 0;
+        virtual bool hasFailed() = 0;
+
+        string incomeDescription() {
+            return configuration().incomeDescription;
+        }
+
+        Cents incomeAmount() {
+            return configuration().incomeAmount;
+        }
+
+        Cents overdraft() {
+            return configuration().overdraft;
+        }
+
+        bool isExpenseAcceptable(const Cents expense) {
+            return balance() + overdraft() - expense >= 0;
+        }
+
+        bool hasDueIncomes() {
+            return lastIncomePeriod() < Util::currentYear() * 100 + Util::currentMonth();
+        }
+
+        void insertAllDueIncomes() {
+            const int currentPeriod = Util::currentYear() * 12 + Util::currentMonth() - 1;
+            const int lastPeriod = lastIncomePeriod();
+            int period = lastPeriod > 0 ? lastPeriod / 100 * 12 + lastPeriod % 100 : currentPeriod;
+            if (period <= currentPeriod) {
+                beginTransaction();
+                for (; period <= currentPeriod; period++) {
+                    if (!insertAutoIncome(period % 12 + 1, period / 12)) {
+                        rollbackTransaction();
+                        return;
+                    }
+                }
+                if (!commitTransaction()) {
+                    rollbackTransaction();
+                }
+            }
+        }
+
+};
+
+class SqliteDatabase : public Database {
+
+    public:
+
+        SqliteDatabase(const string filename = DB_FILE) : file(filename) {}
+
+        bool exists() override {
+            return isInMemory() ? db && tableExists("ledger") : Util::fileExists(file);
+        }
+
+        bool isShareable() override {
+            return !isInMemory();
+        }
+
+        bool hasFailed() override {
+            return failed;
+        }
+
+        bool isInMemory() const {
+            return file == MEMORY_DB;
+        }
+
+        // Puts back every trigger a bulk load dropped, using the same definitions the migrations install.
+        bool reinstallTriggers() {
+            if (!executeStatement(" BEGIN IMMEDIATE ")) {
+                return false;
+            }
+            if (!(createCentsTriggers() && createBalanceTriggers() && createIncomePeriodTriggers()
+                    && createMonthlyTriggers() && createRevisionTriggers() && createEpochTriggers())) {
+                executeStatement(" ROLLBACK ");
+                return false;
+            }
+            if (!executeStatement(" COMMIT ")) {
+                executeStatement(" ROLLBACK ");
+                return false;
+            }
+            return true;
+        }
+
+        bool connect() override {
+            if (!db) {
+                if (!openFile(SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE)) {
+                    std::cerr << TextResources::errorDatabase(file, sqlite3_errmsg(db)) << std::endl;
+                    disconnect();
+                    return false;
+                }
+                applyStorageProfile();
+                enableSlowQueryLog();
+                if (tableExists("ledger") && !migrate(true)) {
+                    disconnect();
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool connectReadOnly() override {
+            if (!db && !isInMemory()) {
+                if (!openFile(SQLITE_OPEN_READONLY) || userVersion() < static_cast<int>(migrations().size())) {
+                    disconnect();
+                }
+            }
+            return connect();
+        }
+
+        void disconnect() override {
+            for (auto &cached : statements) {
+                sqlite3_finalize(cached.second);
+            }
+            statements.clear();
+            configLoaded = false;
+            searchProbed = false;
+            monthlyVerified = false;
+            failed = false;
+            sqlite3_close(db);
+            db = NULL;
+        }
+
+        void createTables() override {
+            executeStatement(R"(
+                CREATE TABLE ledger (
+                description TEXT,
+                amount REAL NOT NULL,
+                auto_income INTEGER NOT NULL,
+                created_by TEXT,
+                created_at TIMESTAMP NOT NULL,
+                modified_at TIMESTAMP)
+            )");
+            executeStatement(" CREATE TABLE configuration (k TEXT NOT NULL, v TEXT NOT NULL)");
+            migrate(false);
+        }
+
+        bool insertAutoIncome(int month, int year) override {
+            int requiredSize = 32;
+            char dateInfo[requiredSize];
+            snprintf(dateInfo, requiredSize, " %02d/%d", month, year);
+            const string description = incomeDescription() + dateInfo;
+            const Cents amount = incomeAmount();
+            Statement stmt = statement(" INSERT INTO ledger (description, amount, amount_cents, auto_income, income_period, created_at, created_epoch, created_by) VALUES (?1, ?2 / 100.0, ?2, 1, ?3, datetime('now'), CAST(strftime('%s', 'now') AS INTEGER), 'C++17 Edition') ");
+            sqlite3_bind_text(stmt, 1, description.c_str(), description.length(), NULL);
+            sqlite3_bind_int64(stmt, 2, amount);
+            sqlite3_bind_int(stmt, 3, year * 100 + month);
+            return stmt && sqlite3_step(stmt) == SQLITE_DONE;
+        }
+
+        void insertConfiguration(const string key, const string value) override {
+            Statement stmt = statement(" INSERT INTO configuration (k, v) VALUES (?, ?)");
+            sqlite3_bind_text(stmt, 1, key.c_str(), key.length(), NULL);
+            sqlite3_bind_text(stmt, 2, value.c_str(), value.length(), NULL);
+            if (stmt) {
+                sqlite3_step(stmt);
+            }
+            configLoaded = false;
+        }
+
+        bool insertIntoLedger(const string description, const Cents amount) override {
+            Statement stmt = statement(" INSERT INTO ledger (description, amount, amount_cents, auto_income, created_at, created_epoch, created_by) VALUES (?1, ?2 / 100.0, ?2, 0, datetime('now'), CAST(strftime('%s', 'now') AS INTEGER), 'C++17 Edition') ");
+            sqlite3_bind_text(stmt, 1, description.c_str(), description.length(), NULL);
+            sqlite3_bind_int64(stmt, 2, amount);
+            return sqlite3_step(stmt) == SQLITE_DONE;
+        }
+
+        bool importIntoLedger(const string description, const Cents amount, const string createdAt) override {
+            if (!createdAt.empty() && !Util::isTimestamp(createdAt)) {
+                return false;
+            }
+            const time_t epoch = createdAt.empty() ? time(NULL) : Util::parseTimestamp(createdAt);
+            const string timestamp = Util::formatTimestamp(epoch);
+            Statement stmt = statement(" INSERT INTO ledger (description, amount, amount_cents, auto_income, created_at, created_epoch, created_by) VALUES (?1, ?2 / 100.0, ?2, 0, ?3, ?4, 'C++17 Edition') ");
+            sqlite3_bind_text(stmt, 1, description.c_str(), description.length(), NULL);
+            sqlite3_bind_int64(stmt, 2, amount);
+            sqlite3_bind_text(stmt, 3, timestamp.c_str(), timestamp.length(), NULL);
+            sqlite3_bind_int64(stmt, 4, epoch);
+            return sqlite3_step(stmt) == SQLITE_DONE;
+        }
+
+        void beginTransaction() override {
+            executeStatement(" BEGIN ");
+        }
+
+        bool commitTransaction() override {
+            return executeStatement(" COMMIT ");
+        }
+
+        void rollbackTransaction() override {
+            executeStatement(" ROLLBACK ");
+        }
+
+        Cents balance() override {
+            Statement stmt = statement(" SELECT cents FROM ledger_balance ");
+            return sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0;
+        }
+
+        void recalculateBalance() override {
+            executeStatement(" UPDATE ledger SET amount_cents = CAST(ROUND(amount * 100) AS INTEGER) WHERE amount_cents IS NOT CAST(ROUND(amount * 100) AS INTEGER) ");
+            executeStatement(" INSERT OR REPLACE INTO ledger_balance (id, cents) SELECT 0, COALESCE(SUM(amount_cents), 0) FROM ledger ");
+            executeStatement(" UPDATE ledger_revision SET edits = edits + 1 ");
+        }
+
+        int rebuildMonthly() override {
+            beginTransaction();
+            const int rebuilt = refreshMonthly();
+            if (rebuilt < 0 || !commitTransaction()) {
+                rollbackTransaction();
+                return 0;
+            }
+            monthlyVerified = true;
+            monthlyVersion = dataVersion();
+            return rebuilt;
+        }
+
+        // The full comparison scans the ledger, so it only runs again once another connection has written to the file.
+        // Writes through this connection keep the rollup current by triggers.
+        bool isMonthlyConsistent() override {
+            const int version = dataVersion();
+            if (monthlyVerified && version == monthlyVersion) {
+                return true;
+            }
+            Statement stmt = statement(" WITH actual AS (" + actualMonthly() + ") SELECT NOT EXISTS ("
+                + " SELECT period, income_cents, expense_cents, entries FROM ledger_monthly WHERE entries <> 0 EXCEPT SELECT * FROM actual) "
+                + " AND NOT EXISTS (SELECT * FROM actual EXCEPT SELECT period, income_cents, expense_cents, entries FROM ledger_monthly) ");
+            monthlyVerified = sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0) == 1;
+            monthlyVersion = version;
+            return monthlyVerified;
+        }
+
+        void monthlySummary(std::ostream &out) override {
+            SummaryWriter writer(out);
+            Statement stmt = statement(" SELECT period, income_cents, expense_cents, entries FROM ledger_monthly WHERE entries > 0 ORDER BY period ");
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                writer.month(sqlite3_column_int(stmt, 0), sqlite3_column_int64(stmt, 1), sqlite3_column_int64(stmt, 2), sqlite3_column_int64(stmt, 3));
+            }
+            writer.finish();
+        }
+
+        int64_t transactions(std::ostream &out, const int64_t beforeRowid, const int limit) override {
+            int64_t lastRowid = beforeRowid;
+            Statement stmt = statement(" SELECT ROWID, created_at, amount_cents, description FROM ledger WHERE ROWID < ? ORDER BY ROWID DESC LIMIT ? ");
+            sqlite3_bind_int64(stmt, 1, beforeRowid);
+            sqlite3_bind_int(stmt, 2, limit);
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                lastRowid = sqlite3_column_int64(stmt, 0);
+                out << '\t';
+                out.write(sqlite3ColumnText(stmt, 1), sqlite3_column_bytes(stmt, 1));
+                out << '\t' << Util::formatCents(sqlite3_column_int64(stmt, 2)) << '\t';
+                out.write(sqlite3ColumnText(stmt, 3), sqlite3_column_bytes(stmt, 3));
+                out << '\n';
+            }
+            return lastRowid;
+        }
+
+        SearchTotals search(std::ostream &out, const string terms, const int limit) override {
+            const std::vector<string> words = wordsOf(terms);
+            if (words.empty()) {
+                return SearchTotals{0, 0, 0};
+            }
+            const bool indexed = refreshSearch();
+            Statement stmt = statement(indexed ? R"(
+                SELECT l.created_at, l.amount_cents, l.description FROM search.ledger_search s JOIN ledger l ON l.ROWID = s.ROWID
+                WHERE s.ledger_search MATCH ? ORDER BY s.rank, s.ROWID DESC LIMIT ?
+            )" : " SELECT created_at, amount_cents, description FROM ledger WHERE " + likeOf(words) + " ORDER BY ROWID DESC LIMIT ? ");
+            sqlite3_bind_int(stmt, bindTerms(stmt, indexed, words) + 1, limit);
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                out << '\t';
+                out.write(sqlite3ColumnText(stmt, 0), sqlite3_column_bytes(stmt, 0));
+                out << '\t' << Util::formatCents(sqlite3_column_int64(stmt, 1)) << '\t';
+                out.write(sqlite3ColumnText(stmt, 2), sqlite3_column_bytes(stmt, 2));
+                out << '\n';
+            }
+            Statement totals = statement(" SELECT COUNT(*), COALESCE(SUM(MAX(amount_cents, 0)), 0), COALESCE(SUM(MIN(amount_cents, 0)), 0) FROM ledger WHERE "
+                + (indexed ? string(" ROWID IN (SELECT ROWID FROM search.ledger_search WHERE ledger_search MATCH ?) ") : likeOf(words)));
+            bindTerms(totals, indexed, words);
+            if (sqlite3_step(totals) != SQLITE_ROW) {
+                return SearchTotals{0, 0, 0};
+            }
+            return SearchTotals{sqlite3_column_int64(totals, 0), sqlite3_column_int64(totals, 1), sqlite3_column_int64(totals, 2)};
+        }
+
+        void exportLedger(ExportWriter &writer, const string from, const string to) override {
+            Statement stmt = statement(R"(
+                SELECT created_at, amount_cents, description, auto_income FROM ledger
+                WHERE created_at >= ? AND substr(created_at, 1, 10) <= ? ORDER BY ROWID
+            )");
+            sqlite3_bind_text(stmt, 1, from.c_str(), from.length(), NULL);
+            sqlite3_bind_text(stmt, 2, to.empty() ? "9999-12-31" : to.c_str(), -1, NULL);
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                const char *createdAt = sqlite3ColumnText(stmt, 0);
+                const char *description = sqlite3ColumnText(stmt, 2);
+                writer.row(createdAt ? createdAt : "", sqlite3_column_bytes(stmt, 0), sqlite3_column_int64(stmt, 1),
+                    description ? description : "", sqlite3_column_bytes(stmt, 2), sqlite3_column_int(stmt, 3) == 1);
+            }
+        }
+
+        void loadSnapshot(LedgerSnapshot &snapshot) override {
+            Statement stmt = statement(" SELECT created_epoch, amount_cents, auto_income, description FROM ledger WHERE created_epoch IS NOT NULL ORDER BY ROWID ");
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                const char *description = sqlite3ColumnText(stmt, 3);
+                snapshot.add(sqlite3_column_int64(stmt, 0), sqlite3_column_int64(stmt, 1),
+                    sqlite3_column_int(stmt, 2) == 1, description ? description : "", sqlite3_column_bytes(stmt, 3));
+            }
+        }
+
+        RangeTotals rangeTotals(const int64_t first, const int64_t last, const int signum) override {
+            Statement stmt = statement(R"(
+                SELECT COUNT(*), COALESCE(SUM(amount_cents), 0), COALESCE(MIN(amount_cents), 0), COALESCE(MAX(amount_cents), 0) FROM ledger
+                WHERE created_epoch >= ? AND created_epoch < ? AND (?3 = 0 OR amount_cents * ?3 > 0)
+            )");
+            sqlite3_bind_int64(stmt, 1, first);
+            sqlite3_bind_int64(stmt, 2, last);
+            sqlite3_bind_int(stmt, 3, signum);
+            if (sqlite3_step(stmt) != SQLITE_ROW) {
+                return RangeTotals{0, 0, 0, 0};
+            }
+            return RangeTotals{sqlite3_column_int64(stmt, 0), sqlite3_column_int64(stmt, 1), sqlite3_column_int64(stmt, 2), sqlite3_column_int64(stmt, 3)};
+        }
+
+        void rangeTransactions(std::ostream &out, const int64_t first, const int64_t last, const int limit) override {
+            Statement stmt = statement(R"(
+                SELECT created_at, amount_cents, description FROM ledger
+                WHERE created_epoch >= ? AND created_epoch < ? ORDER BY created_epoch DESC, ROWID DESC LIMIT ?
+            )");
+            sqlite3_bind_int64(stmt, 1, first);
+            sqlite3_bind_int64(stmt, 2, last);
+            sqlite3_bind_int(stmt, 3, limit);
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                out << '\t';
+                out.write(sqlite3ColumnText(stmt, 0), sqlite3_column_bytes(stmt, 0));
+                out << '\t' << Util::formatCents(sqlite3_column_int64(stmt, 1)) << '\t';
+                out.write(sqlite3ColumnText(stmt, 2), sqlite3_column_bytes(stmt, 2));
+                out << '\n';
+            }
+        }
+
+        Cents balanceBefore(const int64_t epoch) override {
+            Statement stmt = statement(" SELECT COALESCE(SUM(amount_cents), 0) FROM ledger WHERE created_epoch >= ? ");
+            sqlite3_bind_int64(stmt, 1, epoch);
+            return balance() - (sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0);
+        }
+
+        const Configuration & configuration() override {
+            const int version = dataVersion();
+            if (!configLoaded || version != configVersion) {
+                std::unordered_map<string, string> entries;
+                if (tableExists("configuration")) {
+                    Statement stmt = statement(" SELECT k, v FROM configuration ");
+                    while (sqlite3_step(stmt) == SQLITE_ROW) {
+                        entries[sqlite3ColumnText(stmt, 0)] = sqlite3ColumnText(stmt, 1);
+                    }
+                }
+                config.load(entries);
+                configVersion = version;
+                configLoaded = true;
+            }
+            return config;
+        }
+
+        int lastIncomePeriod() override {
+            Statement stmt = statement(" SELECT income_period FROM ledger WHERE income_period IS NOT NULL ORDER BY income_period DESC LIMIT 1 ");
+            return sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : 0;
+        }
+
+    private:
+
+        string file;
+        sqlite3 *db = NULL;
+        std::unordered_map<string, sqlite3_stmt *> statements;
+        Configuration config;
+        int configVersion = 0;
+        bool configLoaded = false;
+        bool searchProbed = false;
+        bool searchIndexed = false;
+        bool failed = false;
+        bool monthlyVerified = false;
+        int monthlyVersion = 0;
+        sqlite3_int64 slowQueryNanos = 0;
+        string slowQueryLog;
+
+        // Opening succeeds for directories and files that are no database at all, only the first read tells.
+        bool openFile(const int flags) {
+            if (sqlite3_open_v2(file.c_str(), &db, flags, NULL) != SQLITE_OK) {
+                return false;
+            }
+            sqlite3_busy_timeout(db, BUSY_TIMEOUT_MS);
+            return executeStatement(" SELECT COUNT(*) FROM sqlite_master ");
+        }
+
+        bool executeStatement(const char *sql) {
+            char *err = 0;
+            const bool executed = sqlite3_exec(db, sql, 0, 0, &err) == SQLITE_OK;
+            sqlite3_free(err);
+            return executed;
+        }
+
+        void applyStorageProfile() {
+            const bool fast = configuration().value(CONF_STORAGE_PROFILE, "") == STORAGE_PROFILE_FAST;
+            pragma("journal_mode", CONF_STORAGE_JOURNAL_MODE, fast ? "WAL" : "DELETE");
+            pragma("synchronous", CONF_STORAGE_SYNCHRONOUS, fast ? "NORMAL" : "FULL");
+            pragma("mmap_size", CONF_STORAGE_MMAP_SIZE, fast ? "268435456" : "0");
+            pragma("cache_size", CONF_STORAGE_CACHE_SIZE, fast ? "-65536" : "-2000");
+            pragma("temp_store", CONF_STORAGE_TEMP_STORE, fast || isInMemory() ? "MEMORY" : "DEFAULT");
+        }
+
+        void enableSlowQueryLog() {
+            const string threshold = configuration().value(CONF_SLOW_QUERY_MS, "");
+            if (!threshold.empty() && isdigit(threshold[0])) {
+                slowQueryNanos = static_cast<sqlite3_int64>(std::atof(threshold.c_str()) * 1000000);
+                slowQueryLog = configuration().value(CONF_SLOW_QUERY_LOG, SLOW_QUERY_LOG);
+                sqlite3_trace_v2(db, SQLITE_TRACE_PROFILE, traceSlowQuery, this);
+            }
+        }
+
+        static int traceSlowQuery(unsigned, void *context, void *p, void *x) {
+            SqliteDatabase *database = static_cast<SqliteDatabase *>(context);
+            sqlite3_stmt *stmt = static_cast<sqlite3_stmt *>(p);
+            const sqlite3_int64 nanos = *static_cast<sqlite3_int64 *>(x);
+            const int scanned = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+            const int steps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+            if (nanos < database->slowQueryNanos) {
+                return 0;
+            }
+            char *sql = sqlite3_expanded_sql(stmt);
+            char line[160];
+            snprintf(line, sizeof(line), "%s\t%.3f ms\tfull scan steps %d\tvm steps %d\tchanged %d\t",
+                Util::formatTimestamp(time(NULL)).c_str(), nanos / 1000000.0, scanned, steps,
+                sqlite3_stmt_readonly(stmt) ? 0 : sqlite3_changes(database->db));
+            string statement = line;
+            for (const char *c = sql ? sql : sqlite3_sql(stmt); *c; c++) {
+                if (!isspace(*c)) {
+                    statement += *c;
+                } else if (statement.back() != ' ' && statement.back() != '\t') {
+                    statement += ' ';
+                }
+            }
+            SlowQueryLog::write(database->slowQueryLog, statement + "\n");
+            sqlite3_free(sql);
+            return 0;
+        }
+
+        void pragma(const string name, const string key, const string standard) {
+            const string value = configuration().value(key, standard);
+            for (const char c : value) {
+                if (!isalnum(c) && c != '-') {
+                    return;
+                }
+            }
+            executeStatement((" PRAGMA " + name + " = " + value).c_str());
+        }
+
+        int dataVersion() {
+            Statement stmt = statement(" PRAGMA data_version ");
+            return sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : 0;
+        }
+
+        struct Migration {
+            const char *name;
+            bool (SqliteDatabase::*apply)();
+        };
+
+        static const std::vector<Migration> & migrations() {
+            static const std::vector<Migration> all = {
+                {"integer cents", &SqliteDatabase::migrateCents},
+                {"balance table", &SqliteDatabase::migrateBalance},
+                {"income periods", &SqliteDatabase::migrateIncomePeriod},
+                {"monthly rollup", &SqliteDatabase::migrateMonthly},
+                {"search revisions", &SqliteDatabase::migrateSearch},
+                {"epoch timestamps", &SqliteDatabase::migrateEpoch}
+            };
+            return all;
+        }
+
+        int userVersion() {
+            Statement stmt = statement(" PRAGMA user_version ");
+            return sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : 0;
+        }
+
+        // Every migration runs in its own transaction together with the bump of user_version.
+        // A failing statement rolls the whole step back and stops, so the file never ends up half upgraded.
+        bool migrate(const bool verbose) {
+            const int latest = migrations().size();
+            int version = userVersion();
+            if (version >= latest) {
+                return true;
+            }
+            if (verbose) {
+                std::cerr << TextResources::migrationStarted(file, version, latest) << std::flush;
+            }
+            for (; version < latest; version = userVersion()) {
+                const auto start = std::chrono::steady_clock::now();
+                const Migration &migration = migrations()[version];
+                if (!executeStatement(" BEGIN IMMEDIATE ")) {
+                    return failMigration(version + 1, migration.name);
+                }
+                if (userVersion() != version) {
+                    executeStatement(" ROLLBACK ");
+                    continue;
+                }
+                if (!(this->*migration.apply)()
+                        || !executeStatement((" PRAGMA user_version = " + std::to_string(version + 1)).c_str())
+                        || !executeStatement(" COMMIT ")) {
+                    return failMigration(version + 1, migration.name);
+                }
+                const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                if (verbose) {
+                    std::cerr << TextResources::migrationApplied(version + 1, migration.name, elapsed.count()) << std::flush;
+                }
+            }
+            return true;
+        }
+
+        bool failMigration(const int version, const string name) {
+            std::cerr << TextResources::errorMigration(file, version, name, sqlite3_errmsg(db)) << std::flush;
+            executeStatement(" ROLLBACK ");
+            return false;
+        }
+
+        bool migrateCents() {
+            const bool migrated = columnExists("ledger", "amount_cents") || (
+                executeStatement(" ALTER TABLE ledger ADD COLUMN amount_cents INTEGER ")
+                && executeStatement(" UPDATE ledger SET amount_cents = CAST(ROUND(amount * 100) AS INTEGER) ")
+                && executeStatement(" DROP TRIGGER IF EXISTS ledger_balance_insert ")
+                && executeStatement(" DROP TRIGGER IF EXISTS ledger_balance_update ")
+                && executeStatement(" DROP TRIGGER IF EXISTS ledger_balance_delete ")
+                && executeStatement(" DROP TABLE IF EXISTS ledger_balance "));
+            return migrated && createCentsTriggers();
+        }
+
+        bool createCentsTriggers() {
+            return executeStatement(R"(
+                CREATE TRIGGER IF NOT EXISTS ledger_cents_insert AFTER INSERT ON ledger
+                WHEN NEW.amount_cents IS NULL BEGIN
+                UPDATE ledger SET amount_cents = CAST(ROUND(NEW.amount * 100) AS INTEGER) WHERE rowid = NEW.rowid;
+                END
+            )") && executeStatement(R"(
+                CREATE TRIGGER IF NOT EXISTS ledger_cents_update AFTER UPDATE OF amount ON ledger BEGIN
+                UPDATE ledger SET amount_cents = CAST(ROUND(NEW.amount * 100) AS INTEGER) WHERE rowid = NEW.rowid;
+                END
+            )");
+        }
+
+        bool migrateBalance() {
+            return executeStatement(R"(
+                CREATE TABLE IF NOT EXISTS ledger_balance (
+                id INTEGER PRIMARY KEY CHECK (id = 0),
+                cents INTEGER NOT NULL)
+            )") && createBalanceTriggers()
+                && executeStatement(" INSERT INTO ledger_balance (id, cents) SELECT 0, (SELECT COALESCE(SUM(amount_cents), 0) FROM ledger) WHERE NOT EXISTS (SELECT id FROM ledger_balance) ");
+        }
+
+        bool createBalanceTriggers() {
+            return executeStatement(R"(
+                CREATE TRIGGER IF NOT EXISTS ledger_balance_insert AFTER INSERT ON ledger BEGIN
+                UPDATE ledger_balance SET cents = cents + COALESCE(NEW.amount_cents, CAST(ROUND(NEW.amount * 100) AS INTEGER));
+                END
+            )") && executeStatement(R"(
+                CREATE TRIGGER IF NOT EXISTS ledger_balance_update AFTER UPDATE OF amount_cents ON ledger BEGIN
+                UPDATE ledger_balance SET cents = cents
+                - COALESCE(OLD.amount_cents, CAST(ROUND(OLD.amount * 100) AS INTEGER))
+                + COALESCE(NEW.amount_cents, CAST(ROUND(NEW.amount * 100) AS INTEGER));
+                END
+            )") && executeStatement(R"(
+                CREATE TRIGGER IF NOT EXISTS ledger_balance_delete AFTER DELETE ON ledger BEGIN
+                UPDATE ledger_balance SET cents = cents - COALESCE(OLD.amount_cents, CAST(ROUND(OLD.amount * 100) AS INTEGER));
+                END
+            )");
+        }
+
+        bool migrateIncomePeriod() {
+            const bool migrated = columnExists("ledger", "income_period") || (
+                executeStatement(" ALTER TABLE ledger ADD COLUMN income_period INTEGER ")
+                && executeStatement(R"(
+                    UPDATE ledger SET income_period = CAST(substr(description, -4) AS INTEGER) * 100 + CAST(substr(description, -7, 2) AS INTEGER)
+                    WHERE auto_income = 1
+                )"));
+            return migrated
+                && executeStatement(" CREATE INDEX IF NOT EXISTS ledger_income_period ON ledger (income_period) WHERE income_period IS NOT NULL ")
+                && createIncomePeriodTriggers();
+        }
+
+        bool createIncomePeriodTriggers() {
+            return executeStatement(R"(
+                CREATE TRIGGER IF NOT EXISTS ledger_income_period_insert AFTER INSERT ON ledger
+                WHEN NEW.auto_income = 1 AND NEW.income_period IS NULL BEGIN
+                UPDATE ledger SET income_period = CAST(substr(NEW.description, -4) AS INTEGER) * 100 + CAST(substr(NEW.description, -7, 2) AS INTEGER)
+                WHERE rowid = NEW.rowid;
+                END
+            )");
+        }
+
+        bool migrateMonthly() {
+            const bool monthlyMissing = !tableExists("ledger_monthly");
+            return executeStatement(R"(
+                CREATE TABLE IF NOT EXISTS ledger_monthly (
+                period INTEGER PRIMARY KEY,
+                income_cents INTEGER NOT NULL,
+                expense_cents INTEGER NOT NULL,
+                entries INTEGER NOT NULL)
+            )") && createMonthlyTriggers() && (!monthlyMissing || refreshMonthly() >= 0);
+        }
+
+        bool createMonthlyTriggers() {
+            return executeStatement((" CREATE TRIGGER IF NOT EXISTS ledger_monthly_insert AFTER INSERT ON ledger BEGIN "
+                + monthlyUpsert("NEW", "+") + " END ").c_str())
+                && executeStatement((" CREATE TRIGGER IF NOT EXISTS ledger_monthly_update AFTER UPDATE OF amount_cents, created_at ON ledger BEGIN "
+                + monthlyUpsert("OLD", "-") + monthlyUpsert("NEW", "+") + " END ").c_str())
+                && executeStatement((" CREATE TRIGGER IF NOT EXISTS ledger_monthly_delete AFTER DELETE ON ledger BEGIN "
+                + monthlyUpsert("OLD", "-") + " END ").c_str());
+        }
+
+        bool migrateSearch() {
+            return executeStatement(R"(
+                CREATE TABLE IF NOT EXISTS ledger_revision (
+                id INTEGER PRIMARY KEY CHECK (id = 0),
+                edits INTEGER NOT NULL)
+            )") && createRevisionTriggers()
+                && executeStatement(" INSERT INTO ledger_revision (id, edits) SELECT 0, 0 WHERE NOT EXISTS (SELECT id FROM ledger_revision) ");
+        }
+
+        bool createRevisionTriggers() {
+            return executeStatement(R"(
+                CREATE TRIGGER IF NOT EXISTS ledger_revision_update AFTER UPDATE OF description ON ledger BEGIN
+                UPDATE ledger_revision SET edits = edits + 1;
+                END
+            )") && executeStatement(R"(
+                CREATE TRIGGER IF NOT EXISTS ledger_revision_delete AFTER DELETE ON ledger BEGIN
+                UPDATE ledger_revision SET edits = edits + 1;
+                END
+            )");
+        }
+
+        bool migrateEpoch() {
+            const bool migrated = columnExists("ledger", "created_epoch") || (
+                executeStatement(" ALTER TABLE ledger ADD COLUMN created_epoch INTEGER ")
+                && executeStatement(" UPDATE ledger SET created_epoch = CAST(strftime('%s', created_at) AS INTEGER) "));
+            return migrated && createEpochTriggers()
+                && executeStatement(" CREATE INDEX IF NOT EXISTS ledger_created_epoch ON ledger (created_epoch, amount_cents) ");
+        }
+
+        bool createEpochTriggers() {
+            return executeStatement(R"(
+                CREATE TRIGGER IF NOT EXISTS ledger_epoch_insert AFTER INSERT ON ledger
+                WHEN NEW.created_epoch IS NULL BEGIN
+                UPDATE ledger SET created_epoch = CAST(strftime('%s', NEW.created_at) AS INTEGER) WHERE rowid = NEW.rowid;
+                END
+            )") && executeStatement(R"(
+                CREATE TRIGGER IF NOT EXISTS ledger_epoch_update AFTER UPDATE OF created_at ON ledger BEGIN
+                UPDATE ledger SET created_epoch = CAST(strftime('%s', NEW.created_at) AS INTEGER) WHERE rowid = NEW.rowid;
+                END
+            )");
+        }
+
+        int refreshMonthly() {
+            const bool refreshed = executeStatement(" DROP TABLE IF EXISTS temp.actual_monthly ")
+                && executeStatement((" CREATE TEMP TABLE actual_monthly AS " + actualMonthly()).c_str())
+                && executeStatement(R"(
+                    DELETE FROM ledger_monthly WHERE NOT EXISTS (
+                    SELECT period FROM temp.actual_monthly a WHERE a.period = ledger_monthly.period
+                    AND a.income_cents = ledger_monthly.income_cents
+                    AND a.expense_cents = ledger_monthly.expense_cents
+                    AND a.entries = ledger_monthly.entries)
+                )")
+                && executeStatement(" INSERT OR IGNORE INTO ledger_monthly (period, income_cents, expense_cents, entries) SELECT period, income_cents, expense_cents, entries FROM temp.actual_monthly ");
+            const int rebuilt = refreshed ? sqlite3_changes(db) : -1;
+            executeStatement(" DROP TABLE IF EXISTS temp.actual_monthly ");
+            return rebuilt;
+        }
+
+        // The full text index lives in a side file next to the ledger, so the shared schema never depends on FTS5.
+        // It is brought up to date on demand: rows added since the last search are appended, and any edit or delete
+        // counted in ledger_revision, or a row count that does not add up, rebuilds it from scratch.
+        bool refreshSearch() {
+            if (!attachSearch()) {
+                return false;
+            }
+            executeStatement(" BEGIN ");
+            sqlite3_int64 lastRowid = 0, rows = -1, edits = -1, added = 0;
+            bool stale = true;
+            {
+                Statement state = statement(" SELECT last_rowid, rows, edits FROM search.search_state ");
+                if (sqlite3_step(state) == SQLITE_ROW) {
+                    lastRowid = sqlite3_column_int64(state, 0);
+                    rows = sqlite3_column_int64(state, 1);
+                    edits = sqlite3_column_int64(state, 2);
+                }
+            }
+            {
+                Statement current = statement(" SELECT (SELECT edits FROM ledger_revision), (SELECT COUNT(*) FROM ledger), (SELECT COUNT(*) FROM ledger WHERE ROWID > ?) ");
+                sqlite3_bind_int64(current, 1, lastRowid);
+                if (sqlite3_step(current) == SQLITE_ROW) {
+                    added = sqlite3_column_int64(current, 2);
+                    stale = edits != sqlite3_column_int64(current, 0) || rows + added != sqlite3_column_int64(current, 1);
+                }
+            }
+            bool refreshed = true;
+            if (stale) {
+                refreshed = executeStatement(" DELETE FROM search.ledger_search ")
+                    && executeStatement(" INSERT INTO search.ledger_search (rowid, description) SELECT ROWID, description FROM ledger ");
+            } else if (added > 0) {
+                refreshed = executeStatement((" INSERT INTO search.ledger_search (rowid, description) SELECT ROWID, description FROM ledger WHERE ROWID > "
+                    + std::to_string(lastRowid)).c_str());
+            } else {
+                executeStatement(" COMMIT ");
+                return true;
+            }
+            refreshed = refreshed && executeStatement(R"(
+                INSERT OR REPLACE INTO search.search_state (id, last_rowid, rows, edits)
+                SELECT 0, COALESCE(MAX(ROWID), 0), COUNT(*), (SELECT edits FROM ledger_revision) FROM ledger
+            )") && executeStatement(" COMMIT ");
+            if (!refreshed) {
+                executeStatement(" ROLLBACK ");
+            }
+            return refreshed;
+        }
+
+        bool attachSearch() {
+            if (!searchProbed) {
+                searchProbed = true;
+                searchIndexed = false;
+                Statement probe = statement(" SELECT sqlite_compileoption_used('ENABLE_FTS5') ");
+                if (sqlite3_step(probe) != SQLITE_ROW || sqlite3_column_int(probe, 0) != 1) {
+                    return false;
+                }
+                const string index = isInMemory() ? MEMORY_DB : file + SEARCH_SUFFIX;
+                Statement attach = statement(" ATTACH DATABASE ? AS search ");
+                sqlite3_bind_text(attach, 1, index.c_str(), index.length(), NULL);
+                searchIndexed = sqlite3_step(attach) == SQLITE_DONE
+                    && executeStatement(" CREATE VIRTUAL TABLE IF NOT EXISTS search.ledger_search USING fts5(description) ")
+                    && executeStatement(R"(
+                        CREATE TABLE IF NOT EXISTS search.search_state (
+                        id INTEGER PRIMARY KEY CHECK (id = 0),
+                        last_rowid INTEGER NOT NULL,
+                        rows INTEGER NOT NULL,
+                        edits INTEGER NOT NULL)
+                    )");
+            }
+            return searchIndexed;
+        }
+
+        static std::vector<string> wordsOf(const string terms) {
+            std::vector<string> words;
+            std::istringstream stream(terms);
+            for (string word; stream >> word;) {
+                word.erase(std::remove(word.begin(), word.end(), '"'), word.end());
+                if (!word.empty()) {
+                    words.push_back(word);
+                }
+            }
+            return words;
+        }
+
+        static string matchOf(const std::vector<string> &words) {
+            string match;
+            for (const string &word : words) {
+                match += (match.empty() ? "\"" : " \"") + word + "\"*";
+            }
+            return match;
+        }
+
+        static string likeOf(const std::vector<string> &words) {
+            string like;
+            for (size_t i = 0; i < words.size(); i++) {
+                like += (i == 0 ? "" : " AND") + string(" description LIKE ? ESCAPE '\\' ");
+            }
+            return like;
+        }
+
+        static int bindTerms(sqlite3_stmt *stmt, const bool indexed, const std::vector<string> &words) {
+            if (indexed) {
+                const string match = matchOf(words);
+                sqlite3_bind_text(stmt, 1, match.c_str(), match.length(), SQLITE_TRANSIENT);
+                return 1;
+            }
+            for (size_t i = 0; i < words.size(); i++) {
+                string pattern = "%";
+                for (const char c : words[i]) {
+                    pattern += (c == '%' || c == '_' || c == '\\' ? "\\" : "") + string(1, c);
+                }
+                pattern += "%";
+                sqlite3_bind_text(stmt, i + 1, pattern.c_str(), pattern.length(), SQLITE_TRANSIENT);
+            }
+            return words.size();
+        }
+
+        static string centsOf(const string row) {
+            return "COALESCE(" + row + ".amount_cents, CAST(ROUND(" + row + ".amount * 100) AS INTEGER))";
+        }
+
+        static string monthOf(const string row) {
+            return "(CAST(substr(" + row + ".created_at, 1, 4) AS INTEGER) * 100 + CAST(substr(" + row + ".created_at, 6, 2) AS INTEGER))";
+        }
+
+        static string actualMonthly() {
+            return " SELECT " + monthOf("ledger") + " AS period, SUM(MAX(" + centsOf("ledger") + ", 0)) AS income_cents, "
+                + " SUM(MIN(" + centsOf("ledger") + ", 0)) AS expense_cents, COUNT(*) AS entries FROM ledger GROUP BY 1 ";
+        }
+
+        static string monthlyUpsert(const string row, const string sign) {
+            return " INSERT OR IGNORE INTO ledger_monthly (period, income_cents, expense_cents, entries) VALUES (" + monthOf(row) + ", 0, 0, 0); "
+                + " UPDATE ledger_monthly SET income_cents = income_cents " + sign + " MAX(" + centsOf(row) + ", 0), "
+                + " expense_cents = expense_cents " + sign + " MIN(" + centsOf(row) + ", 0), "
+                + " entries = entries " + sign + " 1 WHERE period = " + monthOf(row) + "; ";
+        }
+
+        bool tableExists(const string name) {
+            Statement stmt = statement(" SELECT EXISTS(SELECT name FROM sqlite_master WHERE type = 'table' AND name = ?) ");
+            sqlite3_bind_text(stmt, 1, name.c_str(), name.length(), NULL);
+            return sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0) == 1;
+        }
+
+        bool columnExists(const string table, const string column) {
+            Statement stmt = statement(" SELECT EXISTS(SELECT name FROM pragma_table_info(?) WHERE name = ?) ");
+            sqlite3_bind_text(stmt, 1, table.c_str(), table.length(), NULL);
+            sqlite3_bind_text(stmt, 2, column.c_str(), column.length(), NULL);
+            return sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0) == 1;
+        }
+
+        Statement statement(const string sql) {
+            auto cached = statements.find(sql);
+            if (cached != statements.end()) {
+                return Statement(cached->second);
+            }
+            sqlite3_stmt *stmt;
+            if (sqlite3_prepare_v3(db, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, 0) == SQLITE_OK) {
+                statements.emplace(sql, stmt);
+            } else {
+                std::cerr << TextResources::errorStatement(sqlite3_errmsg(db)) << std::endl;
+                failed = true;
+                stmt = NULL;
+            }
+            return Statement(stmt);
+        }
+
+        const char * sqlite3ColumnText(sqlite3_stmt *stmt, int index) {
+            return reinterpret_cast<const char*>(sqlite3_column_text(stmt, index));
+        }
+
+};
+
+struct JournalRecord {
+    int64_t cents;
+    int64_t createdAt;
+    int64_t previous;
+    int32_t incomePeriod;
+    uint8_t kind;
+    uint8_t length;
+    char text[98];
+};
+
+struct JournalFooter {
+    char magic[8];
+    int64_t records;
+    int64_t balance;
+    int64_t lastConfiguration;
+    int32_t lastIncomePeriod;
+    uint32_t checksum;
+    char reserved[24];
+};
+
+static_assert(sizeof(JournalRecord) == 128, "journal records must have a fixed size");
+static_assert(sizeof(JournalFooter) == 64, "journal footer must have a fixed size");
+
+class JournalDatabase : public Database {
+
+    public:
+
+        JournalDatabase(const string filename = JOURNAL_FILE) : file(filename) {}
+
+        bool exists() override {
+            return Util::fileExists(file);
+        }
+
+        bool isShareable() override {
+            return false;
+        }
+
+        bool hasFailed() override {
+            return false;
+        }
+
+        bool connectReadOnly() override {
+            return connect();
+        }
+
+        bool connect() override {
+            if (fd < 0) {
+                fd = ::open(file.c_str(), O_RDWR | O_CREAT, 0644);
+                if (fd < 0) {
+                    std::cerr << TextResources::errorJournal(file, strerror(errno)) << std::endl;
+                    return false;
+                }
+                if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+                    std::cerr << TextResources::errorJournal(file, errno == EWOULDBLOCK ? "locked by another process" : strerror(errno)) << std::endl;
+                    close(fd);
+                    fd = -1;
+                    return false;
+                }
+                struct stat info;
+                fstat(fd, &info);
+                size = info.st_size;
+                map();
+                if (size > 0 && !mapped) {
+                    std::cerr << TextResources::errorJournal(file, strerror(errno)) << std::endl;
+                    close(fd);
+                    fd = -1;
+                    return false;
+                }
+                if (size > 0 && !readFooter()) {
+                    recover();
+                }
+                loadConfiguration();
+            }
+            return true;
+        }
+
+        void disconnect() override {
+            if (fd >= 0) {
+                unmap();
+                close(fd);
+                fd = -1;
+            }
+        }
+
+        void createTables() override {
+            footer = JournalFooter();
+            footer.lastConfiguration = -1;
+            writeFooter();
+        }
+
+        bool insertAutoIncome(int month, int year) override {
+            int requiredSize = 32;
+            char dateInfo[requiredSize];
+            snprintf(dateInfo, requiredSize, " %02d/%d", month, year);
+            return append(entry(KIND_AUTO_INCOME, incomeDescription() + dateInfo, incomeAmount(), time(NULL), year * 100 + month));
+        }
+
+        void insertConfiguration(const string key, const string value) override {
+            JournalRecord record = entry(KIND_CONFIGURATION, key + '\0' + value, 0, time(NULL), 0);
+            record.previous = footer.lastConfiguration;
+            append(record);
+            loadConfiguration();
+        }
+
+        bool insertIntoLedger(const string description, const Cents amount) override {
+            return append(entry(KIND_ENTRY, description, amount, time(NULL), 0));
+        }
+
+        bool importIntoLedger(const string description, const Cents amount, const string createdAt) override {
+            if (!createdAt.empty() && !Util::isTimestamp(createdAt)) {
+                return false;
+            }
+            return append(entry(KIND_ENTRY, description, amount, Util::parseTimestamp(createdAt), 0));
+        }
+
+        void beginTransaction() override {
+            committed = footer;
+            inTransaction = true;
+        }
+
+        bool commitTransaction() override {
+            inTransaction = false;
+            return fdatasync(fd) == 0;
+        }
+
+        void rollbackTransaction() override {
+            footer = committed;
+            inTransaction = false;
+            writeFooter();
+        }
+
+        Cents balance() override {
+            return footer.balance;
+        }
+
+        void recalculateBalance() override {
+            recover();
+        }
+
+        int rebuildMonthly() override {
+            return 0;
+        }
+
+        bool isMonthlyConsistent() override {
+            return true;
+        }
+
+        void monthlySummary(std::ostream &out) override {
+            struct Totals {
+                Cents income = 0;
+                Cents expense = 0;
+                long entries = 0;
+            };
+            std::map<int, Totals> months;
+            for (int64_t i = 0; i < footer.records; i++) {
+                const JournalRecord &record = at(i);
+                if (record.kind != KIND_CONFIGURATION) {
+                    struct tm date;
+                    const time_t createdAt = record.createdAt;
+                    gmtime_r(&createdAt, &date);
+                    Totals &totals = months[(date.tm_year + 1900) * 100 + date.tm_mon + 1];
+                    (record.cents > 0 ? totals.income : totals.expense) += record.cents;
+                    totals.entries++;
+                }
+            }
+            SummaryWriter writer(out);
+            for (const auto &month : months) {
+                writer.month(month.first, month.second.income, month.second.expense, month.second.entries);
+            }
+            writer.finish();
+        }
+
+        int64_t transactions(std::ostream &out, const int64_t beforeRowid, const int limit) override {
+            int64_t lastRowid = beforeRowid;
+            int written = 0;
+            for (int64_t i = std::min<int64_t>(footer.records, beforeRowid - 1) - 1; i >= 0 && written < limit; i--) {
+                const JournalRecord &record = at(i);
+                if (record.kind != KIND_CONFIGURATION) {
+                    out << '\t' << Util::formatTimestamp(record.createdAt) << '\t' << Util::formatCents(record.cents) << '\t';
+                    out.write(record.text, record.length);
+                    out << '\n';
+                    lastRowid = i + 1;
+                    written++;
+                }
+            }
+            return lastRowid;
+        }
+
+        SearchTotals search(std::ostream &out, const string terms, const int limit) override {
+            std::vector<string> words;
+            std::istringstream stream(lowerCase(terms));
+            for (string word; stream >> word;) {
+                words.push_back(word);
+            }
+            SearchTotals totals = {0, 0, 0};
+            for (int64_t i = footer.records - 1; i >= 0 && !words.empty(); i--) {
+                const JournalRecord &record = at(i);
+                const string description = lowerCase(string(record.text, record.length));
+                if (record.kind == KIND_CONFIGURATION || !std::all_of(words.begin(), words.end(),
+                        [&description](const string &word) { return description.find(word) != string::npos; })) {
+                    continue;
+                }
+                if (totals.matches++ < limit) {
+                    out << '\t' << Util::formatTimestamp(record.createdAt) << '\t' << Util::formatCents(record.cents) << '\t';
+                    out.write(record.text, record.length);
+                    out << '\n';
+                }
+                (record.cents > 0 ? totals.income : totals.expense) += record.cents;
+            }
+            return totals;
+        }
+
+        void exportLedger(ExportWriter &writer, const string from, const string to) override {
+            const int64_t first = from.empty() ? std::numeric_limits<int64_t>::min() : Util::parseTimestamp(from);
+            const int64_t last = to.empty() ? std::numeric_limits<int64_t>::max() : Util::parseTimestamp(to) + 86400;
+            char createdAt[20];
+            for (int64_t i = 0; i < footer.records; i++) {
+                const JournalRecord &record = at(i);
+                if (record.kind != KIND_CONFIGURATION && record.createdAt >= first && record.createdAt < last) {
+                    const time_t epoch = record.createdAt;
+                    struct tm date;
+                    gmtime_r(&epoch, &date);
+                    strftime(createdAt, sizeof(createdAt), "%Y-%m-%d %H:%M:%S", &date);
+                    writer.row(createdAt, 19, record.cents, record.text, record.length, record.kind == KIND_AUTO_INCOME);
+                }
+            }
+        }
+
+        void loadSnapshot(LedgerSnapshot &snapshot) override {
+            for (int64_t i = 0; i < footer.records; i++) {
+                const JournalRecord &record = at(i);
+                if (record.kind != KIND_CONFIGURATION) {
+                    snapshot.add(record.createdAt, record.cents, record.kind == KIND_AUTO_INCOME, record.text, record.length);
+                }
+            }
+        }
+
+        RangeTotals rangeTotals(const int64_t first, const int64_t last, const int signum) override {
+            RangeTotals totals = {0, 0, std::numeric_limits<Cents>::max(), std::numeric_limits<Cents>::min()};
+            for (int64_t i = 0; i < footer.records; i++) {
+                const JournalRecord &record = at(i);
+                if (record.kind != KIND_CONFIGURATION && record.createdAt >= first && record.createdAt < last
+                        && (signum == 0 || record.cents * signum > 0)) {
+                    totals.count++;
+                    totals.sum += record.cents;
+                    totals.min = std::min<Cents>(totals.min, record.cents);
+                    totals.max = std::max<Cents>(totals.max, record.cents);
+                }
+            }
+            return totals.count > 0 ? totals : RangeTotals{0, 0, 0, 0};
+        }
+
+        void rangeTransactions(std::ostream &out, const int64_t first, const int64_t last, const int limit) override {
+            int written = 0;
+            for (int64_t i = footer.records - 1; i >= 0 && written < limit; i--) {
+                const JournalRecord &record = at(i);
+                if (record.kind != KIND_CONFIGURATION && record.createdAt >= first && record.createdAt < last) {
+                    out << '\t' << Util::formatTimestamp(record.createdAt) << '\t' << Util::formatCents(record.cents) << '\t';
+                    out.write(record.text, record.length);
+                    out << '\n';
+                    written++;
+                }
+            }
+        }
+
+        Cents balanceBefore(const int64_t epoch) override {
+            Cents later = 0;
+            for (int64_t i = 0; i < footer.records; i++) {
+                const JournalRecord &record = at(i);
+                if (record.kind != KIND_CONFIGURATION && record.createdAt >= epoch) {
+                    later += record.cents;
+                }
+            }
+            return footer.balance - later;
+        }
+
+        const Configuration & configuration() override {
+            return config;
+        }
+
+        int lastIncomePeriod() override {
+            return footer.lastIncomePeriod;
+        }
+
+    private:
+
+        static const uint8_t KIND_ENTRY = 0;
+        static const uint8_t KIND_AUTO_INCOME = 1;
+        static const uint8_t KIND_CONFIGURATION = 2;
+
+        static string lowerCase(string text) {
+            std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+            return text;
+        }
+
+        string file;
+        int fd = -1;
+        off_t size = 0;
+        const char *mapped = NULL;
+        off_t mappedSize = 0;
+        bool inTransaction = false;
+        JournalFooter footer = JournalFooter();
+        JournalFooter committed = JournalFooter();
+        Configuration config;
+
+        static JournalRecord entry(const uint8_t kind, const string text, const Cents cents, const time_t createdAt, const int incomePeriod) {
+            JournalRecord record = JournalRecord();
+            size_t length = std::min(text.size(), sizeof(record.text));
+            while (length < text.size() && length > 0 && (text[length] & 0xC0) == 0x80) {
+                length--;
+            }
+            memcpy(record.text, text.data(), length);
+            record.length = length;
+            record.kind = kind;
+            record.cents = cents;
+            record.createdAt = createdAt;
+            record.incomePeriod = incomePeriod;
+            record.previous = -1;
+            return record;
+        }
+
+        bool append(const JournalRecord &record) {
+            const int64_t index = footer.records;
+            const JournalFooter previous = footer;
+            footer.records++;
+            if (record.kind == KIND_CONFIGURATION) {
+                footer.lastConfiguration = index;
+            } else {
+                footer.balance += record.cents;
+                footer.lastIncomePeriod = std::max(footer.lastIncomePeriod, record.incomePeriod);
+            }
+            footer.checksum = checksum(footer);
+            char buffer[sizeof(JournalRecord) + sizeof(JournalFooter)];
+            memcpy(buffer, &record, sizeof(JournalRecord));
+            memcpy(buffer + sizeof(JournalRecord), &footer, sizeof(JournalFooter));
+            if (!writeFully(buffer, sizeof(buffer), index * sizeof(JournalRecord))) {
+                std::cerr << TextResources::errorJournal(file, strerror(errno)) << std::endl;
+                footer = previous;
+                writeFooter();
+                return false;
+            }
+            size = footer.records * sizeof(JournalRecord) + sizeof(JournalFooter);
+            if (!inTransaction) {
+                fdatasync(fd);
+            }
+            return true;
+        }
+
+        bool writeFully(const void *data, const size_t length, const off_t offset) {
+            for (size_t done = 0; done < length;) {
+                const ssize_t count = pwrite(fd, static_cast<const char *>(data) + done, length - done, offset + done);
+                if (count < 0 && errno != EINTR) {
+                    return false;
+                } else if (count > 0) {
+                    done += count;
+                }
+            }
+            return true;
+        }
+
+        const JournalRecord & at(const int64_t index) {
+            static const JournalRecord unreadable = entry(KIND_CONFIGURATION, "", 0, 0, 0);
+            if ((index + 1) * (off_t) sizeof(JournalRecord) > mappedSize) {
+                map();
+            }
+            if (!mapped || index < 0 || (index + 1) * (off_t) sizeof(JournalRecord) > mappedSize) {
+                return unreadable;
+            }
+            return reinterpret_cast<const JournalRecord *>(mapped)[index];
+        }
+
+        void map() {
+            unmap();
+            if (size > 0) {
+                void *address = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+                if (address != MAP_FAILED) {
+                    mapped = static_cast<const char *>(address);
+                    mappedSize = size;
+                }
+            }
+        }
+
+        void unmap() {
+            if (mapped) {
+                munmap(const_cast<char *>(mapped), mappedSize);
+                mapped = NULL;
+                mappedSize = 0;
+            }
+        }
+
+        bool readFooter() {
+            if (size < (off_t) sizeof(JournalFooter) || !mapped) {
+                return false;
+            }
+            memcpy(&footer, mapped + size - sizeof(JournalFooter), sizeof(JournalFooter));
+            return memcmp(footer.magic, JOURNAL_MAGIC, sizeof(footer.magic)) == 0
+                && footer.checksum == checksum(footer)
+                && footer.records * (off_t) sizeof(JournalRecord) + (off_t) sizeof(JournalFooter) == size;
+        }
+
+        void recover() {
+            if (size > 0 && !mapped) {
+                return;
+            }
+            footer = JournalFooter();
+            footer.lastConfiguration = -1;
+            const int64_t records = size / sizeof(JournalRecord);
+            for (int64_t i = 0; i < records; i++) {
+                const JournalRecord &record = at(i);
+                if (record.kind == KIND_CONFIGURATION) {
+                    footer.lastConfiguration = i;
+                } else {
+                    footer.balance += record.cents;
+                    footer.lastIncomePeriod = std::max(footer.lastIncomePeriod, record.incomePeriod);
+                }
+            }
+            footer.records = records;
+            writeFooter();
+        }
+
+        void writeFooter() {
+            memcpy(footer.magic, JOURNAL_MAGIC, sizeof(footer.magic));
+            footer.checksum = checksum(footer);
+            size = footer.records * sizeof(JournalRecord) + sizeof(JournalFooter);
+            if (!writeFully(&footer, sizeof(JournalFooter), size - sizeof(JournalFooter))) {
+                std::cerr << TextResources::errorJournal(file, strerror(errno)) << std::endl;
+            } else if (ftruncate(fd, size) == 0) {
+                fdatasync(fd);
+            }
+            map();
+        }
+
+        void loadConfiguration() {
+            std::unordered_map<string, string> entries;
+            for (int64_t i = footer.lastConfiguration; i >= 0 && i < footer.records; i = at(i).previous) {
+                const JournalRecord &record = at(i);
+                const string text(record.text, record.length);
+                const size_t separator = text.find('\0');
+                if (separator != string::npos) {
+                    entries.emplace(text.substr(0, separator), text.substr(separator + 1));
+                }
+            }
+            config.load(entries);
+        }
+
+        static uint32_t checksum(const JournalFooter &footer) {
+            uint32_t hash = 2166136261u;
+            const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&footer);
+            for (size_t i = 0; i < offsetof(JournalFooter, checksum); i++) {
+                hash = (hash ^ bytes[i]) * 16777619u;
+            }
+            return hash;
+        }
+
+};
+
+class MeasuredDatabase : public Database {
+
+    public:
+
+        MeasuredDatabase(Database *measured) : database(measured) {}
+
+        bool exists() override {
+            static Metric &metric = Stats::metric("database.exists");
+            Timer timer(metric);
+            return database->exists();
+        }
+
+        bool connect() override {
+            static Metric &metric = Stats::metric("database.connect");
+            Timer timer(metric);
+            return database->connect();
+        }
+
+        bool connectReadOnly() override {
+            static Metric &metric = Stats::metric("database.connectReadOnly");
+            Timer timer(metric);
+            return database->connectReadOnly();
+        }
+
+        void disconnect() override {
+            static Metric &metric = Stats::metric("database.disconnect");
+            Timer timer(metric);
+            database->disconnect();
+        }
+
+        void createTables() override {
+            static Metric &metric = Stats::metric("database.createTables");
+            Timer timer(metric);
+            database->createTables();
+        }
+
+        bool insertAutoIncome(int month, int year) override {
+            static Metric &metric = Stats::metric("database.insertAutoIncome");
+            Timer timer(metric);
+            return database->insertAutoIncome(month, year);
+        }
+
+        void insertConfiguration(const string key, const string value) override {
+            static Metric &metric = Stats::metric("database.insertConfiguration");
+            Timer timer(metric);
+            database->insertConfiguration(key, value);
+        }
+
+        bool insertIntoLedger(const string description, const Cents amount) override {
+            static Metric &metric = Stats::metric("database.insertIntoLedger");
+            Timer timer(metric);
+            return database->insertIntoLedger(description, amount);
+        }
+
+        bool importIntoLedger(const string description, const Cents amount, const string createdAt) override {
+            static Metric &metric = Stats::metric("database.importIntoLedger");
+            Timer timer(metric);
+            return database->importIntoLedger(description, amount, createdAt);
+        }
+
+        void beginTransaction() override {
+            static Metric &metric = Stats::metric("database.beginTransaction");
+            Timer timer(metric);
+            database->beginTransaction();
+        }
+
+        bool commitTransaction() override {
+            static Metric &metric = Stats::metric("database.commitTransaction");
+            Timer timer(metric);
+            return database->commitTransaction();
+        }
+
+        void rollbackTransaction() override {
+            static Metric &metric = Stats::metric("database.rollbackTransaction");
+            Timer timer(metric);
+            database->rollbackTransaction();
+        }
+
+        Cents balance() override {
+            static Metric &metric = Stats::metric("database.balance");
+            Timer timer(metric);
+            return database->balance();
+        }
+
+        void recalculateBalance() override {
+            static Metric &metric = Stats::metric("database.recalculateBalance");
+            Timer timer(metric);
+            database->recalculateBalance();
+        }
+
+        int rebuildMonthly() override {
+            static Metric &metric = Stats::metric("database.rebuildMonthly");
+            Timer timer(metric);
+            return database->rebuildMonthly();
+        }
+
+        bool isMonthlyConsistent() override {
+            static Metric &metric = Stats::metric("database.isMonthlyConsistent");
+            Timer timer(metric);
+            return database->isMonthlyConsistent();
+        }
+
+        void monthlySummary(std::ostream &out) override {
+            static Metric &metric = Stats::metric("database.monthlySummary");
+            Timer timer(metric);
+            database->monthlySummary(out);
+        }
+
+        int64_t transactions(std::ostream &out, const int64_t beforeRowid, const int limit) override {
+            static Metric &metric = Stats::metric("database.transactions");
+            Timer timer(metric);
+            return database->transactions(out, beforeRowid, limit);
+        }
+
+        SearchTotals search(std::ostream &out, const string terms, const int limit) override {
+            static Metric &metric = Stats::metric("database.search");
+            Timer timer(metric);
+            return database->search(out, terms, limit);
+        }
+
+        void exportLedger(ExportWriter &writer, const string from, const string to) override {
+            static Metric &metric = Stats::metric("database.exportLedger");
+            Timer timer(metric);
+            database->exportLedger(writer, from, to);
+        }
+
+        void loadSnapshot(LedgerSnapshot &snapshot) override {
+            static Metric &metric = Stats::metric("database.loadSnapshot");
+            Timer timer(metric);
+            database->loadSnapshot(snapshot);
+        }
+
+        RangeTotals rangeTotals(const int64_t first, const int64_t last, const int signum) override {
+            static Metric &metric = Stats::metric("database.rangeTotals");
+            Timer timer(metric);
+            return database->rangeTotals(first, last, signum);
+        }
+
+        void rangeTransactions(std::ostream &out, const int64_t first, const int64_t last, const int limit) override {
+            static Metric &metric = Stats::metric("database.rangeTransactions");
+            Timer timer(metric);
+            database->rangeTransactions(out, first, last, limit);
+        }
+
+        Cents balanceBefore(const int64_t epoch) override {
+            static Metric &metric = Stats::metric("database.balanceBefore");
+            Timer timer(metric);
+            return database->balanceBefore(epoch);
+        }
+
+        const Configuration & configuration() override {
+            static Metric &metric = Stats::metric("database.configuration");
+            Timer timer(metric);
+            return database->configuration();
+        }
+
+        int lastIncomePeriod() override {
+            static Metric &metric = Stats::metric("database.lastIncomePeriod");
+            Timer timer(metric);
+            return database->lastIncomePeriod();
+        }
+
+        bool isShareable() override {
+            return database->isShareable();
+        }
+
+        bool hasFailed() override {
+            return database->hasFailed();
+        }
+
+    private:
+
+        std::unique_ptr<Database> database;
+
+};
+
+std::unique_ptr<Database> Database::open(const string filename) {
+    if (filename.size() >= JOURNAL_SUFFIX.size()
+            && filename.compare(filename.size() - JOURNAL_SUFFIX.size(), JOURNAL_SUFFIX.size(), JOURNAL_SUFFIX) == 0) {
+        return std::unique_ptr<Database>(new MeasuredDatabase(new JournalDatabase(filename)));
+    }
+    return std::unique_ptr<Database>(new MeasuredDatabase(new SqliteDatabase(filename)));
+}
+
+class Setup {
+
+    public:
+
+        Setup(Database &database) : db(database) {}
+
+        bool setupOnFirstRun() {
+            bool exists;
+            {
+                Timer timer(Stats::metric("startup.fileExists"));
+                exists = db.exists();
+            }
+            return exists || initialize();
+        }
+
+    private:
+
+        Database &db;
+
+        bool initialize() {
+            Util::print(TextResources::setupPreDatabase());
+            if (!db.connect()) {
+                return false;
+            }
+            db.createTables();
+            Util::print(TextResources::setupPostDatabase());
+            setup();
+            Util::println(TextResources::setupComplete());
+            return true;
+        }
+
+        void setup() {
+            const string descriptionInput = Util::readConfigInput(TextResources::setupDescription(), "pocket money");
+            const string amountInput = Util::readConfigInput(TextResources::setupIncome(), "100");
+            const string overdraftInput = Util::readConfigInput(TextResources::setupOverdraft(), "200");
+            db.insertConfiguration(CONF_INCOME_DESCRIPTION, descriptionInput);
+            db.insertConfiguration(CONF_INCOME_AMOUNT, amountInput);
+            db.insertConfiguration(CONF_OVERDRAFT, overdraftInput);
+            int month = Util::currentMonth();
+            int year = Util::currentYear();
+            db.insertAutoIncome(month, year);
+        }
+
+};
+
+class Wallets {
+
+    public:
+
+        Wallets(const std::vector<string> &paths) {
+            for (const string &path : paths) {
+                DIR *directory = opendir(path.c_str());
+                if (directory) {
+                    std::vector<string> found;
+                    while (struct dirent *file = readdir(directory)) {
+                        const string name = file->d_name;
+                        if (hasSuffix(name, ".db") || hasSuffix(name, JOURNAL_SUFFIX)) {
+                            found.push_back(path + "/" + name);
+                        }
+                    }
+                    closedir(directory);
+                    std::sort(found.begin(), found.end());
+                    files.insert(files.end(), found.begin(), found.end());
+                } else {
+                    files.push_back(path);
+                }
+            }
+            for (const string &file : files) {
+                databases.push_back(Database::open(file));
+            }
+        }
+
+        size_t size() const {
+            return databases.size();
+        }
+
+        Database & at(const size_t index) {
+            return *databases[index];
+        }
+
+        const string & file(const size_t index) const {
+            return files[index];
+        }
+
+        string name(const size_t index) const {
+            const size_t slash = files[index].rfind('/');
+            return slash == string::npos ? files[index] : files[index].substr(slash + 1);
+        }
+
+        bool setupOnFirstRun() {
+            for (size_t i = 0; i < databases.size(); i++) {
+                if (!databases[i]->exists()) {
+                    Util::println(TextResources::activeWallet(name(i)));
+                    Setup setup = Setup(*databases[i]);
+                    if (!setup.setupOnFirstRun()) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        bool catchUp() {
+            std::atomic<size_t> next(0);
+            std::atomic<bool> connected(true);
+            std::vector<std::thread> pool;
+            const size_t workers = std::min<size_t>(databases.size(), std::max(1u, std::thread::hardware_concurrency()));
+            for (size_t i = 0; i < workers; i++) {
+                pool.emplace_back([this, &next, &connected]() {
+                    for (size_t index = next++; index < databases.size(); index = next++) {
+                        if (databases[index]->connect()) {
+                            databases[index]->insertAllDueIncomes();
+                        } else {
+                            connected = false;
+                        }
+                    }
+                });
+            }
+            for (std::thread &worker : pool) {
+                worker.join();
+            }
+            return connected;
+        }
+
+        void disconnect() {
+            for (auto &database : databases) {
+                database->disconnect();
+            }
+        }
+
+    private:
+
+        std::vector<string> files;
+        std::vector<std::unique_ptr<Database>> databases;
+
+        static bool hasSuffix(const string &name, const string &suffix) {
+            return name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+
+};
+
+class WriteBehind {
+
+    public:
+
+        WriteBehind() : worker(&WriteBehind::drain, this) {}
+
+        ~WriteBehind() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                running = false;
+                ready.notify_one();
+            }
+            worker.join();
+        }
+
+        void attach(Database &database) {
+            flush();
+            db = &database;
+            sync();
+        }
+
+        void push(const string description, const Cents amount) {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back(std::make_pair(description, amount));
+            balance += amount;
+            ready.notify_one();
+        }
+
+        void flush() {
+            std::vector<std::pair<string, Cents>> failures;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                drained.wait(lock, [this]() { return pending.empty() && !writing; });
+                failures.swap(failed);
+            }
+            for (const auto &failure : failures) {
+                Util::println(TextResources::errorNotBooked(failure.first, failure.second));
+            }
+            if (db) {
+                sync();
+            }
+        }
+
+        bool hasFailures() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return !failed.empty();
+        }
+
+        Cents currentBalance() const {
+            return balance;
+        }
+
+        bool isExpenseAcceptable(const Cents expense) const {
+            return balance + overdraft - expense >= 0;
+        }
+
+    private:
+
+        Database *db = NULL;
+        Cents balance = 0;
+        Cents overdraft = 0;
+        std::vector<std::pair<string, Cents>> pending;
+        std::vector<std::pair<string, Cents>> failed;
+        bool writing = false;
+        bool running = true;
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::condition_variable drained;
+        std::thread worker;
+
+        void sync() {
+            balance = db->balance();
+            overdraft = db->overdraft();
+        }
+
+        void drain() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                ready.wait(lock, [this]() { return !pending.empty() || !running; });
+                if (pending.empty()) {
+                    return;
+                }
+                std::vector<std::pair<string, Cents>> batch;
+                batch.swap(pending);
+                writing = true;
+                lock.unlock();
+                std::vector<std::pair<string, Cents>> rejected;
+                db->beginTransaction();
+                for (const auto &entry : batch) {
+                    if (!db->insertIntoLedger(entry.first, entry.second)) {
+                        rejected.push_back(entry);
+                    }
+                }
+                if (!db->commitTransaction()) {
+                    db->rollbackTransaction();
+                    rejected = batch;
+                }
+                lock.lock();
+                failed.insert(failed.end(), rejected.begin(), rejected.end());
+                writing = false;
+                drained.notify_all();
+            }
+        }
+
+};
+
+class Loop {
+
+    public:
+
+        Loop(Database &database) : db(&database) {}
+
+        Loop(Wallets &openWallets) : db(&openWallets.at(0)), wallets(&openWallets) {}
+
+        bool loop() {
+            {
+                Timer timer(Stats::metric("startup.connect"));
+                if (!db->connect()) {
+                    return false;
+                }
+            }
+            {
+                Timer timer(Stats::metric("startup.insertAllDueIncomes"));
+                db->insertAllDueIncomes();
+            }
+            {
+                Timer timer(Stats::metric("startup.firstBalance"));
+                writer.attach(*db);
+            }
+            Util::print(TextResources::currentBalance(writer.currentBalance()));
+            handleInfo();
+            bool looping = true;
+            while(looping) {
+                const string input = Util::input(TextResources::enterInput());
+                if (writer.hasFailures()) {
+                    writer.flush();
+                }
+                std::unique_ptr<Timer> timer(input == KEY_ADD || input == KEY_SUB || input == KEY_WALLET || input == KEY_SEARCH || input == KEY_RANGE || input == KEY_PERIOD
+                    ? NULL : new Timer(Stats::metric("command " + commandName(input))));
+                if (input == KEY_ADD) {
+                    handleAdd();
+                } else if (input == KEY_SUB) {
+                    handleSub();
+                } else if (input == KEY_SHOW) {
+                    handleShow();
+                } else if (input == KEY_OLDER) {
+                    handleOlder();
+                } else if (input == KEY_HELP) {
+                    handleHelp();
+                } else if (input == KEY_SUMMARY) {
+                    handleSummary();
+                } else if (input == KEY_WALLET) {
+                    handleWallet();
+                } else if (input == KEY_STATS) {
+                    handleStats();
+                } else if (input == KEY_SEARCH) {
+                    handleSearch();
+                } else if (input == KEY_RANGE) {
+                    handleRange();
+                } else if (input == KEY_PERIOD) {
+                    handlePeriod();
+                } else if (input == KEY_RECALCULATE) {
+                    handleRecalculate();
+                } else if (input == KEY_QUIT) {
+                    writer.flush();
+                    looping = false;
+                } else if (input.substr(0, 1) == KEY_ADD || input.substr(0, 1) == KEY_SUB){
+                    omg();
+                } else {
+                    handleInfo();
+                }
+            }
+            db->disconnect();
+            Util::println(TextResources::bye());
+            return true;
+        }
+
+    private:
+
+        Database *db;
+        Wallets *wallets = NULL;
+        WriteBehind writer;
+        std::unique_ptr<LedgerSnapshot> snapshot;
+        int64_t pageCursor = std::numeric_limits<int64_t>::max();
+        const string KEY_ADD = "+";
+        const string KEY_SUB = "-";
+        const string KEY_SHOW = "=";
+        const string KEY_OLDER = ">";
+        const string KEY_HELP = "?";
+        const string KEY_QUIT = ":";
+        const string KEY_RECALCULATE = "!";
+        const string KEY_SUMMARY = "#";
+        const string KEY_WALLET = "@";
+        const string KEY_STATS = "%";
+        const string KEY_SEARCH = "/";
+        const string KEY_RANGE = "$";
+        const string KEY_PERIOD = "~";
+        const string KEY_OTHER = "other";
+
+        string commandName(const string &input) const {
+            for (const string *key : {&KEY_SHOW, &KEY_OLDER, &KEY_HELP, &KEY_QUIT, &KEY_RECALCULATE, &KEY_SUMMARY, &KEY_STATS}) {
+                if (input == *key) {
+                    return input;
+                }
+            }
+            return KEY_OTHER;
+        }
+
+        void addToLedger(const int signum, const string successMessage) {
+            const string description = Util::input(TextResources::enterDescription());
+            const string amountStr = Util::input(TextResources::enterAmount());
+            const Cents amount = Util::parseCents(amountStr);
+            Timer timer(Stats::metric("command " + (signum == 1 ? KEY_ADD : KEY_SUB)));
+            if (amount > 0) {
+                if (signum == 1 || writer.isExpenseAcceptable(amount)) {
+                    writer.push(description, amount * signum);
+                    snapshot.reset();
+                    Util::println(successMessage);
+                    Util::print(TextResources::currentBalance(writer.currentBalance()));
+                } else {
+                    Util::println(TextResources::errorTooExpensive());
+                }
+            } else if (amount < 0) {
+                Util::println(TextResources::errorNegativeAmount());
+            } else {
+                Util::println(TextResources::errorZeroOrInvalidAmount());
+            }
+        }
+
+        void handleAdd() {
+            addToLedger(1, TextResources::incomeBooked());
+        }
+
+        void handleSub() {
+            addToLedger(-1, TextResources::expenseBooked());
+        }
+
+        void handleShow() {
+            writer.flush();
+            const int pageSize = db->configuration().pageSize;
+            Util::print(TextResources::formattedBalance(db->balance(), pageSize));
+            pageCursor = db->transactions(std::cout, std::numeric_limits<int64_t>::max(), pageSize);
+        }
+
+        void handleOlder() {
+            writer.flush();
+            Util::print(TextResources::olderTransactions());
+            const int64_t cursor = db->transactions(std::cout, pageCursor, db->configuration().pageSize);
+            if (cursor == pageCursor) {
+                Util::println(TextResources::noOlderTransactions());
+            }
+            pageCursor = cursor;
+        }
+
+        void handleSummary() {
+            writer.flush();
+            if (!db->isMonthlyConsistent()) {
+                Util::println(TextResources::monthlyRebuilt(db->rebuildMonthly()));
+            }
+            Util::print(TextResources::monthlySummary());
+            db->monthlySummary(std::cout);
+        }
+
+        void handleRecalculate() {
+            writer.flush();
+            db->recalculateBalance();
+            db->rebuildMonthly();
+            writer.attach(*db);
+            snapshot.reset();
+            Util::println(TextResources::balanceRecalculated());
+            Util::print(TextResources::currentBalance(writer.currentBalance()));
+        }
+
+        void handleWallet() {
+            if (!wallets || wallets->size() < 2) {
+                Util::println(TextResources::errorSingleWallet());
+                return;
+            }
+            writer.flush();
+            Util::print(TextResources::wallets());
+            for (size_t i = 0; i < wallets->size(); i++) {
+                Util::println(TextResources::walletEntry(i + 1, wallets->name(i), wallets->at(i).balance()));
+            }
+            const size_t selected = std::atol(Util::input(TextResources::enterWallet()).c_str());
+            if (selected < 1 || selected > wallets->size()) {
+                Util::println(TextResources::errorInvalidWallet());
+                return;
+            }
+            Timer timer(Stats::metric("command " + KEY_WALLET));
+            db = &wallets->at(selected - 1);
+            writer.attach(*db);
+            snapshot.reset();
+            pageCursor = std::numeric_limits<int64_t>::max();
+            Util::println(TextResources::activeWallet(wallets->name(selected - 1)));
+            Util::print(TextResources::currentBalance(writer.currentBalance()));
+        }
+
+        void handleSearch() {
+            const string terms = Util::input(TextResources::enterSearch());
+            if (terms.find_first_not_of(" \t\"") == string::npos) {
+                Util::println(TextResources::errorEmptySearch());
+                return;
+            }
+            Timer timer(Stats::metric("command " + KEY_SEARCH));
+            writer.flush();
+            Util::print(TextResources::searchResults(db->configuration().pageSize));
+            const SearchTotals totals = db->search(std::cout, terms, db->configuration().pageSize);
+            Util::print(TextResources::searchTotals(totals.matches, totals.income, totals.expense));
+        }
+
+        void handlePeriod() {
+            const string from = Util::input(TextResources::enterFrom());
+            const string to = Util::input(TextResources::enterTo());
+            if (!Util::isDate(from) || !Util::isDate(to)) {
+                Util::println(TextResources::errorInvalidRange());
+                return;
+            }
+            Timer timer(Stats::metric("command " + KEY_PERIOD));
+            writer.flush();
+            const int64_t first = from.empty() ? RANGE_FIRST : Util::parseTimestamp(from);
+            const int64_t last = to.empty() ? RANGE_LAST : Util::parseTimestamp(to) + 86400;
+            const int pageSize = db->configuration().pageSize;
+            Util::print(TextResources::periodTransactions(pageSize));
+            db->rangeTransactions(std::cout, first, last, pageSize);
+            const RangeTotals all = db->rangeTotals(first, last, 0);
+            const RangeTotals income = db->rangeTotals(first, last, 1);
+            const Cents closing = to.empty() ? db->balance() : db->balanceBefore(last);
+            Util::print(TextResources::periodBalance(all.count, income.sum, all.sum - income.sum, closing - all.sum, closing));
+        }
+
+        void handleRange() {
+            const string from = Util::input(TextResources::enterFrom());
+            const string to = Util::input(TextResources::enterTo());
+            const string sign = Util::input(TextResources::enterSign());
+            if (!Util::isDate(from) || !Util::isDate(to) || !(sign.empty() || sign == KEY_ADD || sign == KEY_SUB)) {
+                Util::println(TextResources::errorInvalidRange());
+                return;
+            }
+            Timer timer(Stats::metric("command " + KEY_RANGE));
+            const bool loading = !snapshot;
+            if (loading) {
+                writer.flush();
+                const auto start = std::chrono::steady_clock::now();
+                snapshot.reset(new LedgerSnapshot());
+                db->loadSnapshot(*snapshot);
+                snapshot->seal();
+                const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                Util::println(TextResources::snapshotLoaded(snapshot->size(), elapsed.count()));
+            }
+            const int64_t first = from.empty() ? RANGE_FIRST : Util::parseTimestamp(from);
+            const int64_t last = to.empty() ? RANGE_LAST : Util::parseTimestamp(to) + 86400;
+            const int signum = sign == KEY_ADD ? 1 : sign == KEY_SUB ? -1 : 0;
+            const auto start = std::chrono::steady_clock::now();
+            const RangeTotals totals = snapshot->aggregate(first, last, signum);
+            const double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            Util::print(TextResources::rangeTotals(totals.count, totals.sum, totals.min, totals.max));
+            if (loading) {
+                const auto sqlStart = std::chrono::steady_clock::now();
+                const RangeTotals sqlTotals = db->rangeTotals(first, last, signum);
+                const double sqlMicros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sqlStart).count();
+                Util::print(TextResources::rangeComparison(micros, sqlMicros, totals.count == sqlTotals.count && totals.sum == sqlTotals.sum
+                    && totals.min == sqlTotals.min && totals.max == sqlTotals.max));
+            } else {
+                Util::print(TextResources::rangeTiming(micros));
+            }
+        }
+
+        void handleStats() {
+            Util::print(TextResources::stats());
+            Stats::print(std::cout);
+        }
+
+        void handleHelp() {
+            Util::print(TextResources::help());
+        }
+
+        void handleInfo() {
+            Util::print(TextResources::info());
+        }
+
+        void omg() {
+            Util::println(TextResources::errorOmg());
+        }
+
+};
+
+class OneShot {
+
+    public:
+
+        OneShot(Database &database) : db(database) {}
+
+        int run(const std::vector<string> &args) {
+            if (!db.exists()) {
+                Util::println(TextResources::errorNoDatabase());
+                return 1;
+            }
+            const string &command = args[0];
+            const bool reading = (command == CMD_BALANCE && args.size() == 1) || (command == CMD_LAST && args.size() <= 2);
+            if (reading && !connect(false)) {
+                return 1;
+            } else if (command == CMD_BALANCE && args.size() == 1) {
+                const Cents balance = db.balance();
+                if (!db.hasFailed()) {
+                    Util::println(Util::formatCents(balance));
+                }
+            } else if ((command == CMD_ADD || command == CMD_SUB) && args.size() > 1) {
+                return book(command == CMD_ADD ? 1 : -1, Util::parseCents(args[1]), join(args, 2));
+            } else if (command == CMD_LAST && args.size() <= 2) {
+                db.transactions(std::cout, std::numeric_limits<int64_t>::max(),
+                    args.size() == 2 ? std::max(1, std::atoi(args[1].c_str())) : db.configuration().pageSize);
+            } else {
+                Util::println(TextResources::oneShotUsage());
+                return 1;
+            }
+            const bool failed = db.hasFailed();
+            db.disconnect();
+            return failed ? 1 : 0;
+        }
+
+        static bool isCommand(const string &arg) {
+            return arg == CMD_BALANCE || arg == CMD_ADD || arg == CMD_SUB || arg == CMD_LAST;
+        }
+
+    private:
+
+        Database &db;
+        static constexpr const char *CMD_BALANCE = "balance";
+        static constexpr const char *CMD_ADD = "add";
+        static constexpr const char *CMD_SUB = "sub";
+        static constexpr const char *CMD_LAST = "last";
+
+        bool connect(const bool writing) {
+            if (!(writing ? db.connect() : db.connectReadOnly())) {
+                return false;
+            }
+            if (db.hasDueIncomes()) {
+                db.disconnect();
+                if (!db.connect()) {
+                    return false;
+                }
+                db.insertAllDueIncomes();
+            }
+            return true;
+        }
+
+        int book(const int signum, const Cents amount, const string description) {
+            if (amount < 0) {
+                Util::println(TextResources::errorNegativeAmount());
+            } else if (amount == 0) {
+                Util::println(TextResources::errorZeroOrInvalidAmount());
+            } else if (connect(true)) {
+                const bool acceptable = signum == 1 || db.isExpenseAcceptable(amount);
+                const bool booked = acceptable && db.insertIntoLedger(description, amount * signum);
+                if (booked) {
+                    Util::println(Util::formatCents(db.balance()));
+                } else if (acceptable) {
+                    Util::println(TextResources::errorNotBooked(description, amount * signum));
+                } else {
+                    Util::println(TextResources::errorTooExpensive());
+                }
+                db.disconnect();
+                return booked ? 0 : 1;
+            }
+            return 1;
+        }
+
+        static string join(const std::vector<string> &args, const size_t from) {
+            string joined;
+            for (size_t i = from; i < args.size(); i++) {
+                joined += (i == from ? "" : " ") + args[i];
+            }
+            return joined;
+        }
+
+};
+
+class Import {
+
+    public:
+
+        Import(Database &database) : db(database) {}
+
+        int importFrom(const string filename) {
+            if (!db.exists()) {
+                Util::println(TextResources::errorNoDatabase());
+                return 1;
+            } else if (filename.empty() || filename == "-") {
+                return importCsv(std::cin);
+            }
+            std::ifstream file(filename);
+            if (!file) {
+                Util::println(TextResources::errorFileNotFound(filename));
+                return 1;
+            }
+            return importCsv(file);
+        }
+
+    private:
+
+        Database &db;
+
+        int importCsv(std::istream &in) {
+            const auto start = std::chrono::steady_clock::now();
+            CsvReader reader(in);
+            std::vector<string> fields;
+            long imported = 0;
+            long committed = 0;
+            long skipped = 0;
+            long rejected = 0;
+            bool saved = true;
+            if (!db.connect()) {
+                return 1;
+            }
+            db.beginTransaction();
+            while (saved && reader.next(fields)) {
+                const Cents amount = fields.size() > 1 ? Util::parseCents(fields[1]) : 0;
+                if (amount == 0) {
+                    skipped++;
+                    continue;
+                }
+                if (!db.importIntoLedger(fields[0], amount, fields.size() > 2 ? fields[2] : "")) {
+                    rejected++;
+                    continue;
+                }
+                if (++imported % IMPORT_BATCH_SIZE == 0) {
+                    saved = db.commitTransaction();
+                    if (saved) {
+                        committed = imported;
+                        db.beginTransaction();
+                    }
+                }
+            }
+            saved = saved && db.commitTransaction();
+            if (!saved) {
+                db.rollbackTransaction();
+                db.disconnect();
+                Util::println(TextResources::errorImportNotSaved(committed));
+                return 1;
+            }
+            const bool failed = db.hasFailed();
+            db.disconnect();
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            Util::println(TextResources::importComplete(imported, skipped, rejected, elapsed.count()));
+            return failed ? 1 : 0;
+        }
+
+};
+
+class Export {
+
+    public:
+
+        Export(Database &database) : db(database) {}
+
+        int exportTo(const std::vector<string> &args) {
+            string from;
+            string to;
+            string filename;
+            size_t i = 1;
+            for (; i + 1 < args.size() && (args[i] == ARG_FROM || args[i] == ARG_TO); i += 2) {
+                (args[i] == ARG_FROM ? from : to) = args[i + 1];
+            }
+            if (i < args.size()) {
+                filename = args[i++];
+            }
+            if (args.empty() || (args[0] != FORMAT_CSV && args[0] != FORMAT_JSONL) || i < args.size() || !Util::isDate(from) || !Util::isDate(to)) {
+                Util::println(TextResources::exportUsage());
+                return 1;
+            } else if (!db.exists()) {
+                Util::println(TextResources::errorNoDatabase());
+                return 1;
+            }
+            const bool toStdout = filename.empty() || filename == "-";
+            const int fd = toStdout ? STDOUT_FILENO : ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                Util::println(TextResources::errorFileNotWritable(filename));
+                return 1;
+            }
+            const auto start = std::chrono::steady_clock::now();
+            ExportWriter writer(fd, args[0] == FORMAT_JSONL);
+            if (!db.connectReadOnly()) {
+                if (!toStdout) {
+                    close(fd);
+                }
+                return 1;
+            }
+            db.exportLedger(writer, from, to);
+            db.disconnect();
+            const bool complete = writer.finish();
+            if (!toStdout) {
+                close(fd);
+                const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                Util::println(complete ? TextResources::exportComplete(writer.written(), elapsed.count())
+                    : TextResources::errorFileNotWritable(filename));
+            }
+            return complete ? 0 : 1;
+        }
+
+    private:
+
+        Database &db;
+
+};
+
+class Frame {
+
+    public:
+
+        static bool send(const int fd, const string &payload) {
+            const uint32_t length = htonl(payload.size());
+            return transfer(fd, reinterpret_cast<const char *>(&length), sizeof(length))
+                && transfer(fd, payload.data(), payload.size());
         }
 
-        string transactions() {
-            string result = "";
-            sqlite3_stmt *stmt;
-            sqlite3_prepare_v2(db, " SELECT created_at, amount, description FROM ledger ORDER BY ROWID DESC LIMIT 30 ", -1, &stmt, 0);
-            while (sqlite3_step(stmt) == SQLITE_ROW) {
-                const string isoDatetime(sqlite3ColumnText(stmt, 0));
-                const string amount = Util::toFormattedString(sqlite3_column_double(stmt, 1));
-                const string description(sqlite3ColumnText(stmt, 2));
-                result += "\t" + isoDatetime + "\t" + amount + "\t" + description + "\n";
+        static bool receive(const int fd, string &payload) {
+            uint32_t length;
+            if (!fill(fd, reinterpret_cast<char *>(&length), sizeof(length)) || ntohl(length) > FRAME_LIMIT) {
+                return false;
             }
-            sqlite3_finalize(stmt);
-            return result;
+            payload.resize(ntohl(length));
+            return fill(fd, &payload[0], payload.size());
         }
 
-        string incomeDescription() {
-            sqlite3_stmt *stmt;
-            sqlite3_prepare_v2(db, " SELECT v FROM configuration WHERE k = ?", -1, &stmt, 0);
-            sqlite3_bind_text(stmt, 1, CONF_INCOME_DESCRIPTION.c_str(), CONF_INCOME_DESCRIPTION.length(), NULL);
-            sqlite3_step(stmt);
-            const string description(sqlite3ColumnText(stmt, 0));
-            sqlite3_finalize(stmt);
-            return description;
+        static std::vector<string> split(const string &payload) {
+            std::vector<string> fields;
+            size_t start = 0;
+            for (size_t tab = payload.find('\t'); tab != string::npos; tab = payload.find('\t', start)) {
+                fields.push_back(payload.substr(start, tab - start));
+                start = tab + 1;
+            }
+            fields.push_back(payload.substr(start));
+            return fields;
         }
 
-        double incomeAmount() {
-            sqlite3_stmt *stmt;
-            sqlite3_prepare_v2(db, " SELECT v FROM configuration WHERE k = ?", -1, &stmt, 0);
-            sqlite3_bind_text(stmt, 1, CONF_INCOME_AMOUNT.c_str(), CONF_INCOME_AMOUNT.length(), NULL);
-            sqlite3_step(stmt);
-            const string amount(sqlite3ColumnText(stmt, 0));
-            sqlite3_finalize(stmt);
-            return std::atof(amount.c_str());
+        static string ok(const string &body) {
+            return "ok\t" + body;
         }
 
-        double overdraft() {
-            sqlite3_stmt *stmt;
-            sqlite3_prepare_v2(db, " SELECT v FROM configuration WHERE k = ?", -1, &stmt, 0);
-            sqlite3_bind_text(stmt, 1, CONF_OVERDRAFT.c_str(), CONF_OVERDRAFT.length(), NULL);
-            sqlite3_step(stmt);
-            const string overdraft(sqlite3ColumnText(stmt, 0));
-            sqlite3_finalize(stmt);
-            return std::atof(overdraft.c_str());
+        static string error(const string &body) {
+            return "error\t" + body;
         }
 
-        bool isExpenseAcceptable(const float expense) {
-            return balance() + overdraft() - expense >= 0;
-        }
+    private:
 
-        void insertAllDueIncomes() {
-            typedef struct {
-                int month;
-                int year;
-            } DueDate;
-            std::list<DueDate> dueDates = {};
-            DueDate dueDate;
-            dueDate.month = Util::currentMonth();
-            dueDate.year = Util::currentYear();
-            while(!hasAutoIncomeForMonth(dueDate.month, dueDate.year)) {
-                DueDate currentDueDate;
-                currentDueDate.month = dueDate.month;
-                currentDueDate.year = dueDate.year;
-                dueDates.push_back(currentDueDate);
-                if (dueDate.month > 1) {
-                    dueDate.month -= 1;
-                } else {
-                    dueDate.year -= 1;
-                    dueDate.month = 12;
+        static bool transfer(const int fd, const char *data, size_t length) {
+            while (length > 0) {
+                const ssize_t sent = ::send(fd, data, length, MSG_NOSIGNAL);
+                if (sent < 0 && errno == EINTR) {
+                    continue;
+                } else if (sent <= 0) {
+                    return false;
                 }
+                data += sent;
+                length -= sent;
             }
-            while(!dueDates.empty()) {
-                DueDate nextDueDate = dueDates.back();
-                dueDates.pop_back();
-                insertAutoIncome(nextDueDate.month, nextDueDate.year);
-            }
-        }
-
-    private:
-
-        sqlite3 *db = NULL;
-
-        void executeStatement(const char *sql) {
-            char *err = 0;
-            sqlite3_exec(db, sql, 0, 0, &err);
-            sqlite3_free(err);
-        }
-
-        const char * sqlite3ColumnText(sqlite3_stmt *stmt, int index) {
-            return reinterpret_cast<const char*>(sqlite3_column_text(stmt, index));
+            return true;
         }
 
-        bool hasAutoIncomeForMonth(const int month, const int year) {
-            const int requiredSize = 10;
-            char dateInfo[requiredSize];
-            snprintf(dateInfo, requiredSize, "%% %02d/%d", month, year);
-            sqlite3_stmt *stmt;
-            sqlite3_prepare_v2(db, " SELECT EXISTS( "\
-                        " SELECT auto_income FROM ledger "\
-                        " WHERE auto_income = 1 "\
-                        " AND description LIKE ? )", -1, &stmt, 0);
-            sqlite3_bind_text(stmt, 1, dateInfo, strlen(dateInfo), NULL);
-            sqlite3_step(stmt);
-            int match = sqlite3_column_int(stmt, 0);
-            sqlite3_finalize(stmt);
-            return match == 1;
+        static bool fill(const int fd, char *data, size_t length) {
+            while (length > 0) {
+                const ssize_t received = ::recv(fd, data, length, 0);
+                if (received < 0 && errno == EINTR) {
+                    continue;
+                } else if (received <= 0) {
+                    return false;
+                }
+                data += received;
+                length -= received;
+            }
+            return true;
         }
 
 };
 
-class Setup {
+class Daemon {
 
     public:
 
-        Setup(Database database) {
-            db = database;
-        }
+        Daemon(Wallets &openWallets, const string socket) : wallets(openWallets), socket(socket),
+            balances(new std::atomic<Cents>[openWallets.size()]) {}
 
-        void setupOnFirstRun() {
-            if (!Util::fileExists(DB_FILE)) {
-                initialize();
+        bool run() {
+            for (size_t i = 0; i < wallets.size(); i++) {
+                if (!wallets.at(i).exists()) {
+                    Util::println(TextResources::errorMissingWallet(wallets.name(i)));
+                    return false;
+                }
+            }
+            if (!wallets.catchUp()) {
+                return false;
+            }
+            for (size_t i = 0; i < wallets.size(); i++) {
+                balances[i] = wallets.at(i).balance();
+            }
+            period = currentPeriod();
+            const int listener = listen();
+            if (listener < 0 || pipe2(wake, O_CLOEXEC | O_NONBLOCK) < 0) {
+                close(listener);
+                Util::println(TextResources::errorSocket(socket));
+                return false;
             }
+            serve(listener);
+            close(wake[0]);
+            close(wake[1]);
+            close(listener);
+            unlink(socket.c_str());
+            Util::println(TextResources::daemonStopped());
+            return true;
         }
 
     private:
 
-        Database db;
+        struct Job {
+            size_t wallet;
+            std::function<string(Database &)> work;
+            std::promise<string> reply;
+        };
 
-        void initialize() {
-            Util::print(TextResources::setupPreDatabase());
-            db.connect();
-            db.createTables();
-            Util::print(TextResources::setupPostDatabase());
-            setup();
-            Util::println(TextResources::setupComplete());
+        static volatile sig_atomic_t interrupted;
+
+        Wallets &wallets;
+        const string socket;
+        std::unique_ptr<std::atomic<Cents>[]> balances;
+        int period = 0;
+        std::deque<Job> jobs;
+        std::mutex jobsMutex;
+        std::condition_variable jobsReady;
+        bool writing = true;
+        std::deque<int> clients;
+        std::vector<int> idle;
+        std::set<int> active;
+        int wake[2] = {-1, -1};
+        std::mutex clientsMutex;
+        std::condition_variable clientsReady;
+        bool reading = true;
+
+        static void interrupt(int) {
+            interrupted = 1;
         }
 
-        void setup() {
-            const string descriptionInput = Util::readConfigInput(TextResources::setupDescription(), "pocket money");
-            const string amountInput = Util::readConfigInput(TextResources::setupIncome(), "100");
-            const string overdraftInput = Util::readConfigInput(TextResources::setupOverdraft(), "200");
-            db.insertConfiguration(CONF_INCOME_DESCRIPTION, descriptionInput);
-            db.insertConfiguration(CONF_INCOME_AMOUNT, amountInput);
-            db.insertConfiguration(CONF_OVERDRAFT, overdraftInput);
-            int month = Util::currentMonth();
-            int year = Util::currentYear();
-            db.insertAutoIncome(month, year);
+        static int currentPeriod() {
+            return Util::currentYear() * 12 + Util::currentMonth();
         }
 
-};
+        int listen() {
+            struct sockaddr_un address = {};
+            address.sun_family = AF_UNIX;
+            if (socket.size() >= sizeof(address.sun_path)) {
+                return -1;
+            }
+            strcpy(address.sun_path, socket.c_str());
+            unlink(socket.c_str());
+            const int listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            if (listener < 0 || bind(listener, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) < 0
+                    || ::listen(listener, SOMAXCONN) < 0) {
+                close(listener);
+                return -1;
+            }
+            return listener;
+        }
 
-class Loop {
+        void serve(const int listener) {
+            struct sigaction action = {};
+            action.sa_handler = interrupt;
+            sigaction(SIGINT, &action, NULL);
+            sigaction(SIGTERM, &action, NULL);
+            sigset_t signals, previous;
+            sigemptyset(&signals);
+            sigaddset(&signals, SIGINT);
+            sigaddset(&signals, SIGTERM);
+            pthread_sigmask(SIG_BLOCK, &signals, &previous);
+            std::thread writer(&Daemon::write, this);
+            std::vector<std::thread> readers;
+            for (int i = 0; i < DAEMON_READERS; i++) {
+                readers.emplace_back(&Daemon::read, this);
+            }
+            pthread_sigmask(SIG_SETMASK, &previous, NULL);
+            Util::println(TextResources::daemonListening(socket, wallets.size()));
+            std::cout.flush();
+            while (!interrupted) {
+                std::vector<struct pollfd> ready = {{listener, POLLIN, 0}, {wake[0], POLLIN, 0}};
+                {
+                    std::lock_guard<std::mutex> lock(clientsMutex);
+                    for (const int client : idle) {
+                        ready.push_back({client, POLLIN, 0});
+                    }
+                }
+                if (poll(ready.data(), ready.size(), -1) < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    Util::println(TextResources::errorAccept(strerror(errno)));
+                    break;
+                }
+                if (ready[1].revents) {
+                    char drained[64];
+                    while (::read(wake[0], drained, sizeof(drained)) > 0) {}
+                }
+                if ((ready[0].revents & POLLIN) && !admit(listener)) {
+                    break;
+                }
+                dispatch(ready);
+            }
+            {
+                std::lock_guard<std::mutex> lock(clientsMutex);
+                reading = false;
+                for (const int client : clients) {
+                    close(client);
+                }
+                for (const int client : idle) {
+                    close(client);
+                }
+                for (const int client : active) {
+                    shutdown(client, SHUT_RDWR);
+                }
+                clientsReady.notify_all();
+            }
+            for (std::thread &reader : readers) {
+                reader.join();
+            }
+            {
+                std::lock_guard<std::mutex> lock(jobsMutex);
+                writing = false;
+                jobsReady.notify_one();
+            }
+            writer.join();
+        }
 
-    public:
+        bool admit(const int listener) {
+            const int client = accept(listener, NULL, NULL);
+            if (client >= 0) {
+                // Readers only get a client once it is readable, but a client sending part of a frame and going quiet
+                // would still hold one in recv. The timeouts make such a client lose its connection instead.
+                struct timeval timeout = {DAEMON_TIMEOUT_MS / 1000, DAEMON_TIMEOUT_MS % 1000 * 1000};
+                setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                std::lock_guard<std::mutex> lock(clientsMutex);
+                idle.push_back(client);
+            } else if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(DAEMON_BACKOFF_MS));
+            } else if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED) {
+                Util::println(TextResources::errorAccept(strerror(errno)));
+                return false;
+            }
+            return true;
+        }
 
-        Loop(Database database) {
-            db = database;
+        // Hands every idle client with a pending request to the readers, which answer exactly one request
+        // and then put the client back, so a client keeping its connection open does not block a reader.
+        void dispatch(const std::vector<struct pollfd> &ready) {
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            for (size_t i = 2; i < ready.size(); i++) {
+                if (ready[i].revents) {
+                    idle.erase(std::find(idle.begin(), idle.end(), ready[i].fd));
+                    clients.push_back(ready[i].fd);
+                    clientsReady.notify_one();
+                }
+            }
         }
 
-        void loop() {
-            db.connect();
-            db.insertAllDueIncomes();
-            Util::print(TextResources::currentBalance(db.balance()));
-            handleInfo();
-            bool looping = true;
-            while(looping) {
-                const string input = Util::input(TextResources::enterInput());
-                if (input == KEY_ADD) {
-                    handleAdd();
-                } else if (input == KEY_SUB) {
-                    handleSub();
-                } else if (input == KEY_SHOW) {
-                    handleShow();
-                } else if (input == KEY_HELP) {
-                    handleHelp();
-                } else if (input == KEY_QUIT) {
-                    looping = false;
-                } else if (input.substr(0, 1) == KEY_ADD || input.substr(0, 1) == KEY_SUB){
-                    omg();
+        void wakeUp() {
+            const char signal = 0;
+            while (::write(wake[1], &signal, 1) < 0 && errno == EINTR) {}
+        }
+
+        void read() {
+            std::vector<std::unique_ptr<Database>> connections(wallets.size());
+            while (true) {
+                int client;
+                {
+                    std::unique_lock<std::mutex> lock(clientsMutex);
+                    clientsReady.wait(lock, [this]() { return !clients.empty() || !reading; });
+                    if (!reading) {
+                        break;
+                    }
+                    client = clients.front();
+                    clients.pop_front();
+                    active.insert(client);
+                }
+                string request;
+                const bool open = Frame::receive(client, request) && Frame::send(client, handle(request, connections));
+                bool keep;
+                {
+                    std::lock_guard<std::mutex> lock(clientsMutex);
+                    active.erase(client);
+                    keep = open && reading;
+                    if (keep) {
+                        idle.push_back(client);
+                    }
+                }
+                if (keep) {
+                    wakeUp();
                 } else {
-                    handleInfo();
+                    close(client);
+                }
+            }
+            for (auto &connection : connections) {
+                if (connection) {
+                    connection->disconnect();
                 }
             }
-            db.disconnect();
-            Util::println(TextResources::bye());
         }
 
-    private:
+        string handle(const string &request, std::vector<std::unique_ptr<Database>> &connections) {
+            const std::vector<string> fields = Frame::split(request);
+            const long wallet = find(fields.size() > 1 ? fields[1] : "");
+            if (wallet < 0) {
+                return Frame::error(TextResources::errorInvalidWallet());
+            } else if (fields[0] == "balance") {
+                // Other processes may write to shareable wallets, so only the others are served from the cache.
+                if (wallets.at(wallet).isShareable()) {
+                    Database *reader = connection(wallet, connections);
+                    return reader ? Frame::ok(Util::formatCents(reader->balance()))
+                        : Frame::error(TextResources::errorUnavailableWallet(wallets.name(wallet)));
+                }
+                return Frame::ok(Util::formatCents(balances[wallet]));
+            } else if ((fields[0] == "add" || fields[0] == "sub") && fields.size() > 3) {
+                return book(wallet, fields[0] == "add" ? 1 : -1, Util::parseCents(fields[2]), fields[3]);
+            } else if (fields[0] == "show") {
+                const int limit = fields.size() > 2 ? std::atoi(fields[2].c_str()) : 0;
+                if (wallets.at(wallet).isShareable()) {
+                    Database *reader = connection(wallet, connections);
+                    return reader ? show(*reader, limit)
+                        : Frame::error(TextResources::errorUnavailableWallet(wallets.name(wallet)));
+                }
+                return submit(wallet, [this, limit](Database &db) { return show(db, limit); });
+            }
+            return Frame::error(TextResources::errorUnknownCommand());
+        }
 
-        Database db;
-        const string KEY_ADD = "+";
-        const string KEY_SUB = "-";
-        const string KEY_SHOW = "=";
-        const string KEY_HELP = "?";
-        const string KEY_QUIT = ":";
+        Database * connection(const size_t wallet, std::vector<std::unique_ptr<Database>> &connections) {
+            if (!connections[wallet]) {
+                std::unique_ptr<Database> connection = Database::open(wallets.file(wallet));
+                if (!connection->connect()) {
+                    return NULL;
+                }
+                connections[wallet] = std::move(connection);
+            }
+            return connections[wallet].get();
+        }
 
-        void addToLedger(const int signum, const string successMessage) {
-            const string description = Util::input(TextResources::enterDescription());
-            const string amountStr = Util::input(TextResources::enterAmount());
-            double amount = std::atof(amountStr.c_str());
-            if (amount > 0) {
-                if (signum == 1 || db.isExpenseAcceptable(amount)) {
-                    db.insertIntoLedger(description, amount * signum);
-                    Util::println(successMessage);
-                    Util::print(TextResources::currentBalance(db.balance()));
-                } else {
-                    Util::println(TextResources::errorTooExpensive());
+        long find(const string &name) const {
+            if (name.empty()) {
+                return 0;
+            }
+            for (size_t i = 0; i < wallets.size(); i++) {
+                if (wallets.name(i) == name || wallets.file(i) == name) {
+                    return i;
                 }
-            } else if (amount < 0) {
-                Util::println(TextResources::errorNegativeAmount());
-            } else {
-                Util::println(TextResources::errorZeroOrInvalidAmount());
             }
+            return -1;
         }
 
-        void handleAdd() {
-            addToLedger(1, TextResources::incomeBooked());
+        string book(const size_t wallet, const int signum, const Cents amount, const string description) {
+            if (amount < 0) {
+                return Frame::error(TextResources::errorNegativeAmount());
+            } else if (amount == 0) {
+                return Frame::error(TextResources::errorZeroOrInvalidAmount());
+            }
+            return submit(wallet, [this, wallet, signum, amount, description](Database &db) {
+                if (signum == -1 && !db.isExpenseAcceptable(amount)) {
+                    return Frame::error(TextResources::errorTooExpensive());
+                }
+                if (!db.insertIntoLedger(description, amount * signum)) {
+                    return Frame::error(TextResources::errorNotBooked(description, amount * signum));
+                }
+                balances[wallet] = db.balance();
+                return Frame::ok((signum == 1 ? TextResources::incomeBooked() : TextResources::expenseBooked())
+                    + "\n" + TextResources::currentBalance(balances[wallet]));
+            });
         }
 
-        void handleSub() {
-            addToLedger(-1, TextResources::expenseBooked());
+        static string show(Database &db, const int limit) {
+            const int pageSize = limit > 0 ? limit : db.configuration().pageSize;
+            std::ostringstream out;
+            out << TextResources::formattedBalance(db.balance(), pageSize);
+            db.transactions(out, std::numeric_limits<int64_t>::max(), pageSize);
+            return Frame::ok(out.str());
         }
 
-        void handleShow() {
-            Util::print(TextResources::formattedBalance(db.balance(), db.transactions()));
+        string submit(const size_t wallet, std::function<string(Database &)> work) {
+            std::future<string> reply;
+            {
+                std::lock_guard<std::mutex> lock(jobsMutex);
+                jobs.push_back(Job{wallet, work, std::promise<string>()});
+                reply = jobs.back().reply.get_future();
+                jobsReady.notify_one();
+            }
+            return reply.get();
         }
 
-        void handleHelp() {
-            Util::print(TextResources::help());
+        void write() {
+            std::unique_lock<std::mutex> lock(jobsMutex);
+            while (writing || !jobs.empty()) {
+                jobsReady.wait_for(lock, std::chrono::minutes(1), [this]() { return !jobs.empty() || !writing; });
+                std::deque<Job> batch;
+                batch.swap(jobs);
+                lock.unlock();
+                catchUp();
+                commit(batch);
+                lock.lock();
+            }
         }
 
-        void handleInfo() {
-            Util::print(TextResources::info());
+        void catchUp() {
+            if (period != currentPeriod()) {
+                period = currentPeriod();
+                for (size_t i = 0; i < wallets.size(); i++) {
+                    wallets.at(i).insertAllDueIncomes();
+                    balances[i] = wallets.at(i).balance();
+                }
+            }
         }
 
-        void omg() {
-            Util::println(TextResources::errorOmg());
+        void commit(std::deque<Job> &batch) {
+            std::vector<bool> open(wallets.size(), false);
+            std::vector<string> replies;
+            for (Job &job : batch) {
+                if (!open[job.wallet]) {
+                    wallets.at(job.wallet).beginTransaction();
+                    open[job.wallet] = true;
+                }
+                replies.push_back(job.work(wallets.at(job.wallet)));
+            }
+            std::vector<bool> failed(wallets.size(), false);
+            for (size_t i = 0; i < open.size(); i++) {
+                if (open[i] && !wallets.at(i).commitTransaction()) {
+                    wallets.at(i).rollbackTransaction();
+                    balances[i] = wallets.at(i).balance();
+                    failed[i] = true;
+                }
+            }
+            for (size_t i = 0; i < batch.size(); i++) {
+                const size_t wallet = batch[i].wallet;
+                batch[i].reply.set_value(failed[wallet]
+                    ? Frame::error(TextResources::errorNotSaved(wallets.name(wallet))) : replies[i]);
+            }
         }
 
 };
 
-    string TextResources::banner() {
-        return R"(
+volatile sig_atomic_t Daemon::interrupted = 0;
+
+    const string & TextResources::banner() {
+        static const string text = Util::expand(R"(
 <TAB> _                                 _   _
 <TAB>(_|   |_/o                        | | | |
 <TAB>  |   |      ,_  _|_         __,  | | | |  _ _|_
@@ -433,23 +3618,33 @@ class Loop {
 <TAB>C++17 Edition
 
 
-)";
+)");
+        return text;
     }
 
-    string TextResources::info() {
-        return R"(
+    const string & TextResources::info() {
+        static const string text = Util::expand(R"(
 <TAB>Commands:
 <TAB>- press plus (+) to add an irregular income
 <TAB>- press minus (-) to add an expense
 <TAB>- press equals (=) to show balance and last transactions
+<TAB>- press greater-than (>) to show older transactions
+<TAB>- press hash (#) to show monthly and yearly summaries
+<TAB>- press at (@) to switch to another wallet
+<TAB>- press percent (%) to show timings of database operations and commands
+<TAB>- press slash (/) to search descriptions
+<TAB>- press dollar ($) to sum up incomes or expenses between two dates
+<TAB>- press tilde (~) to show transactions and balances between two dates
+<TAB>- press exclamation mark (!) to recalculate the balance after editing the database by hand
 <TAB>- press question mark (?) for even more info about this program
 <TAB>- press colon (:) to exit
 
-)";
+)");
+        return text;
     }
 
-    string TextResources::help() {
-        return R"(
+    const string & TextResources::help() {
+        static const string text = Util::expand(R"(
 <TAB>Virtuallet is a tool to act as your virtual wallet. Wow...
 <TAB>Virtuallet is accessible via terminal and uses a Sqlite database to store all its data.
 <TAB>On first start Virtuallet will be configured and requires some input
@@ -467,9 +3662,12 @@ class Loop {
 <TAB>for all days in the past since the last registered regular income.
 <TAB>So if you have specified a monthly income and haven't run Virtuallet for three months
 <TAB>it will auto-create three regular incomes when you boot it the next time if you like it or not.
+<TAB>The month of every regular income is stored as YYYYMM in the income_period column of the ledger,
+<TAB>so you can edit its description without Virtuallet booking that month again.
 
 <TAB>Virtuallet will also allow you to add irregular incomes and expenses manually.
-<TAB>It can also display the current balance and the 30 most recent transactions.
+<TAB>It can also display the current balance and the most recent transactions, 30 at a time.
+<TAB>Press greater-than (>) to page back further. Set page_size in the configuration table to change the page size.
 
 <TAB>The configured overdraft will be considered if an expense is registered.
 <TAB>For instance if your overdraft equals the default value of 200
@@ -480,112 +3678,481 @@ class Loop {
 
 <TAB>As a free gift to you I have added a modified_at field in the ledger table. Feel free to make use of it.
 
-)";
+<TAB>Storage is tuned for safety by default. Add the row storage_profile = fast to the configuration table
+<TAB>to use WAL journaling with normal sync, a 256 MB mmap, a 64 MB page cache and in-memory temp storage.
+<TAB>Single settings can be overridden with the keys storage_journal_mode, storage_synchronous,
+<TAB>storage_mmap_size, storage_cache_size and storage_temp_store, which take the values of the matching PRAGMA.
+
+<TAB>Amounts are calculated exactly in cents which are stored in the amount_cents column of the ledger.
+<TAB>Edit the amount column as before and amount_cents will follow automatically.
+<TAB>The current balance is kept in the ledger_balance table and updated by triggers on the ledger table.
+<TAB>The same goes for the monthly totals in the ledger_monthly table, which back the summaries shown by hash (#).
+<TAB>If your Sqlite-Browser bypasses them, press exclamation mark (!) to recalculate both from the ledger.
+<TAB>Searching with slash (/) uses a full text index in a file next to the database ending in -search.
+<TAB>It is brought up to date on every search and can be deleted at any time.
+
+<TAB>To bulk import a bank export run virtuallet with --import followed by a csv file (or - for stdin).
+<TAB>Every row holds a description, an amount and optionally a yyyy-mm-dd or yyyy-mm-dd hh:mm:ss timestamp.
+<TAB>Rows without an amount are skipped and rows with any other timestamp are rejected.
+<TAB>Run virtuallet with --export csv or --export jsonl followed by a file (or nothing for stdout) to write the ledger out.
+<TAB>Add --from and --to with a yyyy-mm-dd date to limit the export. Csv exports can be imported again.
+
+<TAB>Run virtuallet with --journal to keep the wallet in an append-only binary journal instead of Sqlite.
+<TAB>It starts instantly and writes as little as possible, but a Sqlite-Browser won't help you there
+<TAB>and only one Virtuallet at a time can open it. Descriptions in the journal are cut after 98 bytes.
+<TAB>Run virtuallet with --memory to keep everything in memory without touching your disk. Everything is gone once you quit.
+<TAB>Run virtuallet with --wallets followed by wallet files or directories to open several wallets at once.
+<TAB>Every directory contributes its .db and .journal files. Regular incomes are added to all wallets in parallel.
+<TAB>Run virtuallet with --daemon [--socket path] [wallets] to keep wallets open and serve them over a Unix socket.
+<TAB>Requests are frames of a 4 byte big endian length followed by tab separated fields:
+<TAB>balance, add or sub with amount and description, or show with an optional limit, each after the wallet name.
+<TAB>An empty wallet name selects the first wallet. Use client.out from the c++ directory to talk to the daemon.
+<TAB>For scripts and shell prompts run virtuallet balance, virtuallet add <amount> [description],
+<TAB>virtuallet sub <amount> [description] or virtuallet last [n]. These print their result without a banner and exit.
+<TAB>Start virtuallet with --stats followed by a file name to write all timings as JSON into that file on exit.
+<TAB>Set slow_query_ms in the configuration table to log every statement taking at least that many milliseconds
+<TAB>together with its duration, its full table scan and virtual machine steps and the rows it changed. The log is written to ../virtuallet_slow.log
+<TAB>or the file set as slow_query_log and rotated once it grows beyond 1 MB.
+
+)");
+        return text;
     }
 
-    string TextResources::setupPreDatabase() {
-        return R"(
+    const string & TextResources::setupPreDatabase() {
+        static const string text = Util::expand(R"(
 <TAB>Database file not found.
 <TAB>Database will be initialized. This may take a while... NOT.
-)";
+)");
+        return text;
     }
 
-    string TextResources::setupPostDatabase() {
-        return R"(
+    const string & TextResources::setupPostDatabase() {
+        static const string text = Util::expand(R"(
 <TAB>Database initialized.
 <TAB>Are you prepared for some configuration? If not I don't care. There is no way to exit, muhahahar.
 <TAB>Press enter to accept the default or input something else. There is no validation
 <TAB>because I know you will not make a mistake. No second chances. If you f**k up,
 <TAB>you will have to either delete the database file or edit it using a sqlite database browser.
 
-)";
+)");
+        return text;
     }
 
-    string TextResources::setupComplete() {
-        return "setup complete, have fun";
+    const string & TextResources::setupComplete() {
+        static const string text = "setup complete, have fun";
+        return text;
     }
 
-    string TextResources::errorOmg() {
-        return "OMFG RTFM YOU FOOL you are supposed to only enter + or - not anything else after that";
+    const string & TextResources::errorOmg() {
+        static const string text = "OMFG RTFM YOU FOOL you are supposed to only enter + or - not anything else after that";
+        return text;
     }
 
-    string TextResources::errorZeroOrInvalidAmount() {
-        return "amount is zero or invalid -> action aborted";
+    const string & TextResources::errorZeroOrInvalidAmount() {
+        static const string text = "amount is zero or invalid -> action aborted";
+        return text;
     }
 
-    string TextResources::errorNegativeAmount() {
-        return "amount must be positive -> action aborted";
+    const string & TextResources::errorNegativeAmount() {
+        static const string text = "amount must be positive -> action aborted";
+        return text;
     }
 
-    string TextResources::incomeBooked() {
-        return "income booked";
+    const string & TextResources::incomeBooked() {
+        static const string text = "income booked";
+        return text;
     }
 
-    string TextResources::expenseBooked() {
-        return "expense booked successfully";
+    const string & TextResources::expenseBooked() {
+        static const string text = "expense booked successfully";
+        return text;
     }
 
-    string TextResources::errorTooExpensive() {
-        return "sorry, too expensive -> action aborted";
+    const string & TextResources::errorTooExpensive() {
+        static const string text = "sorry, too expensive -> action aborted";
+        return text;
     }
 
-    string TextResources::enterInput() {
-        return "input";
+    const string & TextResources::enterInput() {
+        static const string text = "input";
+        return text;
     }
 
-    string TextResources::enterDescription() {
-        return "description (optional)";
+    const string & TextResources::enterDescription() {
+        static const string text = "description (optional)";
+        return text;
     }
 
-    string TextResources::enterAmount() {
-        return "amount";
+    const string & TextResources::enterAmount() {
+        static const string text = "amount";
+        return text;
     }
 
-    string TextResources::bye() {
-        return "see ya";
+    const string & TextResources::bye() {
+        static const string text = "see ya";
+        return text;
     }
 
-    string TextResources::currentBalance(const double balance) {
-        string result = R"(
-<TAB>current balance: ?
-
-)";
-        return Util::replaceAll(result, "?", Util::toFormattedString(balance));
+    const string & TextResources::balanceRecalculated() {
+        static const string text = "balance recalculated from ledger";
+        return text;
     }
 
-    string TextResources::formattedBalance(const double balance, const string formattedBalance) {
-        string result = R"(
+    string TextResources::currentBalance(const Cents balance) {
+        static const string result = Util::expand(R"(
 <TAB>current balance: ?
 
-<TAB>last transactions (up to 30)
+)");
+        return Util::fill(result, Util::formatCents(balance));
+    }
+
+    string TextResources::formattedBalance(const Cents balance, const int pageSize) {
+        static const string result = Util::expand(R"(<TAB>last transactions (up to ?)
 <TAB>----------------------------
-)";
-        return Util::replaceAll(result, "?", Util::toFormattedString(balance)) + formattedBalance;
+)");
+        return currentBalance(balance) + Util::fill(result, std::to_string(pageSize));
+    }
+
+    const string & TextResources::olderTransactions() {
+        static const string text = Util::expand(R"(
+<TAB>older transactions
+<TAB>------------------
+)");
+        return text;
+    }
+
+    const string & TextResources::noOlderTransactions() {
+        static const string text = "no older transactions";
+        return text;
+    }
+
+    const string & TextResources::wallets() {
+        static const string text = Util::expand(R"(
+<TAB>open wallets
+<TAB>------------
+)");
+        return text;
+    }
+
+    string TextResources::walletEntry(const size_t number, const string name, const Cents balance) {
+        return "\t" + std::to_string(number) + "\t" + name + "\t" + Util::formatCents(balance);
+    }
+
+    const string & TextResources::enterWallet() {
+        static const string text = "wallet number";
+        return text;
+    }
+
+    string TextResources::activeWallet(const string name) {
+        return "active wallet: " + name;
+    }
+
+    const string & TextResources::errorSingleWallet() {
+        static const string text = "only one wallet is open, start virtuallet with --wallets to open more";
+        return text;
+    }
+
+    const string & TextResources::errorInvalidWallet() {
+        static const string text = "no such wallet -> action aborted";
+        return text;
+    }
+
+    const string & TextResources::oneShotUsage() {
+        static const string text = "usage: virtuallet balance | add <amount> [description] | sub <amount> [description] | last [n]";
+        return text;
+    }
+
+    const string & TextResources::errorNoWallets() {
+        static const string text = "no wallets found";
+        return text;
+    }
+
+    string TextResources::errorDatabase(const string file, const string reason) {
+        return "cannot use database " + file + ": " + reason;
+    }
+
+    string TextResources::errorStatement(const string reason) {
+        return "database error: " + reason;
+    }
+
+    string TextResources::errorJournal(const string file, const string reason) {
+        return "cannot use journal " + file + ": " + reason;
+    }
+
+    string TextResources::errorNotBooked(const string description, const Cents amount) {
+        return "could not book " + Util::formatCents(amount) + " " + description + ", please enter it again";
+    }
+
+    string TextResources::errorUnavailableWallet(const string name) {
+        return "wallet " + name + " cannot be opened right now";
+    }
+
+    string TextResources::errorMissingWallet(const string name) {
+        return "wallet " + name + " not found, run virtuallet once without arguments to set it up";
+    }
+
+    string TextResources::errorSocket(const string socket) {
+        return "cannot listen on " + socket + " -> daemon aborted";
     }
 
-    string TextResources::setupDescription() {
-        return "enter description for regular income";
+    string TextResources::errorAccept(const string reason) {
+        return "cannot accept connections: " + reason + " -> daemon stopped";
     }
 
-    string TextResources::setupIncome() {
-        return "enter regular income";
+    string TextResources::errorNotSaved(const string name) {
+        return "changes to wallet " + name + " could not be saved, please send them again";
     }
 
-    string TextResources::setupOverdraft() {
-        return "enter overdraft";
+    const string & TextResources::errorUnknownCommand() {
+        static const string text = "unknown command, use balance, add, sub or show";
+        return text;
+    }
+
+    string TextResources::daemonListening(const string socket, const size_t wallets) {
+        return "serving " + std::to_string(wallets) + " wallet(s) on " + socket + ", press ctrl+c to stop";
+    }
+
+    const string & TextResources::daemonStopped() {
+        static const string text = "daemon stopped";
+        return text;
+    }
+
+    const string & TextResources::enterFrom() {
+        static const string text = "from yyyy-mm-dd (empty for the first entry)";
+        return text;
+    }
+
+    const string & TextResources::enterTo() {
+        static const string text = "to yyyy-mm-dd (empty for the last entry)";
+        return text;
+    }
+
+    const string & TextResources::enterSign() {
+        static const string text = "plus (+) for incomes, minus (-) for expenses, empty for both";
+        return text;
+    }
+
+    const string & TextResources::errorInvalidRange() {
+        static const string text = "dates must look like 2024-12-31 -> action aborted";
+        return text;
+    }
+
+    string TextResources::snapshotLoaded(const size_t rows, const double seconds) {
+        return "loaded " + std::to_string(rows) + " entries into memory in " + Util::toFormattedString(seconds) + "s";
+    }
+
+    string TextResources::rangeTotals(const long count, const Cents sum, const Cents min, const Cents max) {
+        return "\n\t" + std::to_string(count) + " entries, total " + Util::formatCents(sum) + ", smallest " + Util::formatCents(min)
+            + ", largest " + Util::formatCents(max) + "\n";
+    }
+
+    string TextResources::rangeComparison(const double micros, const double sqlMicros, const bool matching) {
+        return "\tmemory " + std::to_string(static_cast<long>(micros)) + " us, database " + std::to_string(static_cast<long>(sqlMicros))
+            + " us (" + std::to_string(static_cast<long>(micros > 0 ? sqlMicros / micros : 0)) + "x)"
+            + (matching ? "" : ", results differ, press ! after editing the database by hand") + "\n\n";
+    }
+
+    string TextResources::rangeTiming(const double micros) {
+        return "\tmemory " + std::to_string(static_cast<long>(micros)) + " us\n\n";
+    }
+
+    string TextResources::migrationStarted(const string file, const int from, const int to) {
+        return "\tupgrading " + file + " from schema version " + std::to_string(from) + " to " + std::to_string(to) + "\n";
+    }
+
+    string TextResources::migrationApplied(const int version, const string name, const double seconds) {
+        char elapsed[32];
+        snprintf(elapsed, sizeof(elapsed), "%.2fs", seconds);
+        return "\t- version " + std::to_string(version) + " (" + name + ") applied in " + elapsed + "\n";
+    }
+
+    string TextResources::errorMigration(const string file, const int version, const string name, const string reason) {
+        return "\tcannot upgrade " + file + " to schema version " + std::to_string(version) + " (" + name + "): " + reason
+            + "\n\tthe database stays at schema version " + std::to_string(version - 1) + "\n";
+    }
+
+    string TextResources::periodTransactions(const int pageSize) {
+        static const string result = Util::expand(R"(
+<TAB>latest transactions in period (up to ?)
+<TAB>---------------------------------------
+)");
+        return Util::fill(result, std::to_string(pageSize));
+    }
+
+    string TextResources::periodBalance(const long entries, const Cents income, const Cents expenses, const Cents opening, const Cents closing) {
+        return "\n\t" + std::to_string(entries) + " entries, income " + Util::formatCents(income) + ", expenses " + Util::formatCents(expenses)
+            + "\n\tbalance " + Util::formatCents(opening) + " before and " + Util::formatCents(closing) + " after the period\n\n";
+    }
+
+    const string & TextResources::enterSearch() {
+        static const string text = "search for";
+        return text;
+    }
+
+    const string & TextResources::errorEmptySearch() {
+        static const string text = "nothing to search for";
+        return text;
+    }
+
+    string TextResources::searchResults(const int pageSize) {
+        static const string result = Util::expand(R"(
+<TAB>best matches (up to ?)
+<TAB>----------------------
+)");
+        return Util::fill(result, std::to_string(pageSize));
+    }
+
+    string TextResources::searchTotals(const long matches, const Cents income, const Cents expense) {
+        return "\n\t" + std::to_string(matches) + " matches, income " + Util::formatCents(income)
+            + ", expenses " + Util::formatCents(expense) + ", total " + Util::formatCents(income + expense) + "\n\n";
+    }
+
+    const string & TextResources::stats() {
+        static const string text = Util::expand(R"(
+<TAB>metric                          <TAB>   count<TAB>  total ms<TAB>  p50 us<TAB>  p99 us<TAB>  max us
+<TAB>------------------------------------------------------------------------------------------
+)");
+        return text;
+    }
+
+    const string & TextResources::monthlySummary() {
+        static const string text = Util::expand(R"(
+<TAB>period <TAB>      income<TAB>    expenses<TAB> entries<TAB>     balance
+<TAB>--------------------------------------------------------------------
+)");
+        return text;
+    }
+
+    string TextResources::monthlyRebuilt(const int months) {
+        return "monthly summary was out of date, rebuilt " + std::to_string(months) + " months";
+    }
+
+    const string & TextResources::setupDescription() {
+        static const string text = "enter description for regular income";
+        return text;
+    }
+
+    const string & TextResources::setupIncome() {
+        static const string text = "enter regular income";
+        return text;
+    }
+
+    const string & TextResources::setupOverdraft() {
+        static const string text = "enter overdraft";
+        return text;
     }
 
     string TextResources::setupTemplate(const string description, const string standard) {
         return description + " [default: " + standard + "]";
     }
 
-int main() {
+    const string & TextResources::errorNoDatabase() {
+        static const string text = "database file not found, run virtuallet once without arguments to set it up";
+        return text;
+    }
+
+    string TextResources::errorFileNotFound(const string filename) {
+        return "cannot read " + filename + " -> import aborted";
+    }
+
+    string TextResources::errorFileNotWritable(const string filename) {
+        return "cannot write " + filename + " -> export aborted";
+    }
+
+    const string & TextResources::exportUsage() {
+        static const string text = "usage: virtuallet --export csv|jsonl [--from yyyy-mm-dd] [--to yyyy-mm-dd] [file]";
+        return text;
+    }
+
+    string TextResources::exportComplete(const long exported, const double seconds) {
+        const double rowsPerSecond = seconds > 0 ? exported / seconds : exported;
+        return "exported " + std::to_string(exported) + " rows in " + Util::toFormattedString(seconds) + "s ("
+            + std::to_string(static_cast<long>(rowsPerSecond)) + " rows/s)";
+    }
+
+    string TextResources::errorImportNotSaved(const long saved) {
+        return "import stopped, the database could not save more than the first " + std::to_string(saved) + " rows";
+    }
+
+    string TextResources::importComplete(const long imported, const long skipped, const long rejected, const double seconds) {
+        const double rowsPerSecond = seconds > 0 ? imported / seconds : imported;
+        return "imported " + std::to_string(imported) + " rows, skipped " + std::to_string(skipped)
+            + " rows without an amount, rejected " + std::to_string(rejected) + " rows with an invalid timestamp"
+            + " in " + Util::toFormattedString(seconds) + "s (" + std::to_string(static_cast<long>(rowsPerSecond)) + " rows/s)";
+    }
+
+#ifndef VIRTUALLET_NO_MAIN
+int main(int argc, char *argv[]) {
+	Util::setupConsole();
+	int arg = 1;
+	if (argc > arg + 1 && argv[arg] == ARG_STATS) {
+		Stats::dumpOnExit(argv[arg + 1]);
+		arg += 2;
+	}
+	string file = DB_FILE;
+	if (argc > arg && argv[arg] == ARG_JOURNAL) {
+		file = JOURNAL_FILE;
+		arg++;
+	} else if (argc > arg && argv[arg] == ARG_MEMORY) {
+		file = MEMORY_DB;
+		arg++;
+	}
+	if (argc > arg && argv[arg] == ARG_WALLETS) {
+		Wallets wallets(std::vector<string>(argv + arg + 1, argv + argc));
+		if (wallets.size() == 0) {
+			Util::println(TextResources::errorNoWallets());
+			return 1;
+		}
+		Util::print(TextResources::banner());
+		if (!wallets.setupOnFirstRun() || !wallets.catchUp()) {
+			wallets.disconnect();
+			return 1;
+		}
+		Loop loop = Loop(wallets);
+		const bool looped = loop.loop();
+		wallets.disconnect();
+		return looped ? 0 : 1;
+	}
+	if (argc > arg && argv[arg] == ARG_EXPORT) {
+		std::unique_ptr<Database> database = Database::open(file);
+		Export exporter = Export(*database);
+		return exporter.exportTo(std::vector<string>(argv + arg + 1, argv + argc));
+	}
+	if (argc > arg && OneShot::isCommand(argv[arg])) {
+		std::unique_ptr<Database> database = Database::open(file);
+		OneShot oneShot = OneShot(*database);
+		return oneShot.run(std::vector<string>(argv + arg, argv + argc));
+	}
+	if (argc > arg && argv[arg] == ARG_DAEMON) {
+		string socket = DAEMON_SOCKET;
+		arg++;
+		if (argc > arg + 1 && argv[arg] == ARG_SOCKET) {
+			socket = argv[arg + 1];
+			arg += 2;
+		}
+		Wallets wallets(argc > arg ? std::vector<string>(argv + arg, argv + argc) : std::vector<string>(1, file));
+		if (wallets.size() == 0) {
+			Util::println(TextResources::errorNoWallets());
+			return 1;
+		}
+		Daemon daemon(wallets, socket);
+		const bool served = daemon.run();
+		wallets.disconnect();
+		return served ? 0 : 1;
+	}
+	std::unique_ptr<Database> database = Database::open(file);
+	if (argc > arg && argv[arg] == ARG_IMPORT) {
+		Import import = Import(*database);
+		return import.importFrom(argc > arg + 1 ? argv[arg + 1] : "");
+	}
 	Util::print(TextResources::banner());
-	Database database;
-	Setup setup = Setup(database);
-	setup.setupOnFirstRun();
-	Loop loop = Loop(database);
-	loop.loop();
-	database.disconnect();
-	return 0;
+	Setup setup = Setup(*database);
+	if (!setup.setupOnFirstRun()) {
+		return 1;
+	}
+	Loop loop = Loop(*database);
+	const bool looped = loop.loop();
+	database->disconnect();
+	return looped ? 0 : 1;
 }
+#endif
@@ -43,7 +43,7 @@ elif [ $SELECTED_EDITION == 11 ]; then
   ./virtuallet
 elif [ $SELECTED_EDITION == 12 ]; then
   cd c++
-  gcc -std=c++17 virtuallet.cpp -o virtuallet.out -lstdc++ -lsqlite3 -lm
+  gcc -std=c++17 -O2 virtuallet.cpp -o virtuallet.out -lstdc++ -lsqlite3 -lm -pthread
   ./virtuallet.out
 elif [ $SELECTED_EDITION == 13 ]; then
   cd lisp